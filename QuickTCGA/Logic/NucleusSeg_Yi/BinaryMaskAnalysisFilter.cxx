@@ -1,34 +1,109 @@
-#include <map>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
 
 // itk
 #include "itkImage.h"
 #include "itkBinaryThresholdImageFilter.h"
 #include "itkNumericTraits.h"
-#include "itkConnectedComponentImageFilter.h"
 #include "itkLabelImageToShapeLabelMapFilter.h"
 #include "itkRelabelComponentImageFilter.h"
 
+// openCV
+#include "opencv2/core/core.hpp"
+
 
 // local
 #include "BinaryMaskAnalysisFilter.h"
 #include "itkTypedefs.h"
 #include "HierarchicalMeanshiftClusteringFilter.h"
+#include "LatticeMeanshiftClusteringFilter.h"
+#include "ConnComponents.h"
 
 
 namespace gth818n
 {
+  typedef gth818n::HierarchicalMeanshiftClusteringFilter<float, 2> BreakRegionMeanshiftFilterType;
+  typedef gth818n::LatticeMeanshiftClusteringFilter<float> BreakRegionLatticeMeanshiftFilterType;
+
+  /// Pixels of one object to break, in raster order
+  struct BreakRegionObject
+  {
+    BinaryMaskAnalysisFilter::itkLabelImageType::PixelType label;
+    std::vector<float> x;
+    std::vector<float> y;
+  };
+
+  /// Mean shift cluster label of each point of one object
+  std::vector<long> clusterPointsOfObject(const BreakRegionObject& object, float meanshiftSigma, bool latticeMeanshift, std::ostream& log)
+  {
+    if (latticeMeanshift)
+      {
+        BreakRegionLatticeMeanshiftFilterType ms;
+        ms.setRadius(meanshiftSigma);
+        ms.setInputPoints(&object.x[0], &object.y[0], object.x.size());
+        ms.update();
+        return ms.getLabelOfPoints();
+      }
+
+    BreakRegionMeanshiftFilterType ms(log);
+    ms.setRadius(meanshiftSigma);
+    ms.setInputPoints(&object.x[0], &object.y[0], object.x.size());
+    ms.update();
+    return ms.getLabelOfPoints();
+  }
+
+  /// Mean shift clustering of the points of each object to break. The
+  /// objects are independent; each one only writes its own labels and
+  /// its own log, printed by the caller in the order of the objects.
+  class BreakRegionBody : public cv::ParallelLoopBody
+  {
+  public:
+    BreakRegionBody(const std::vector<BreakRegionObject>& objects, std::vector< std::vector<long> >& labels,
+                    std::vector<std::string>& logs, float meanshiftSigma, bool latticeMeanshift)
+      : m_objects(objects), m_labels(labels), m_logs(logs), m_meanshiftSigma(meanshiftSigma), m_latticeMeanshift(latticeMeanshift) {}
+
+    virtual void operator()(const cv::Range& range) const
+    {
+      for (int io = range.start; io < range.end; ++io)
+        {
+          std::ostringstream log;
+          //dbg
+          log<<"MS cluster "<<m_objects[io].label<<" label. It has "<<m_objects[io].x.size()<<" points......... ";
+          //dbg, end
+          m_labels[io] = clusterPointsOfObject(m_objects[io], m_meanshiftSigma, m_latticeMeanshift, log);
+          m_logs[io] = log.str();
+        }
+    }
+
+  private:
+    const std::vector<BreakRegionObject>& m_objects;
+    std::vector< std::vector<long> >& m_labels;
+    std::vector<std::string>& m_logs;
+    float m_meanshiftSigma;
+    bool m_latticeMeanshift;
+  };
+
+
   BinaryMaskAnalysisFilter::BinaryMaskAnalysisFilter()
   {
     m_featureColoredImage = 0;
+    m_featureColoredImageType = 0;
 
     m_connectedComponentLabelImage = 0;
 
+    m_labelMap = 0;
+    m_labelMapHasPerimeter = false;
+
     m_mpp = -1.0;
 
     m_binaryMask = 0;
     m_inputImage = 0;
 
     m_numberOfObjects = 0;
+    m_availableAttributes = 0;
 
     //m_objectSizeThreshold = 8; ///< smallest cell, sperm, neutrophils, platelets (may be considered as cell fragments) are around 3 micron in one dim. So set 8 um^2 as lower limit
     m_objectSizeThreshold = 3; ///< smallest cell, sperm, neutrophils, platelets (may be considered as cell fragments) are around 3 micron in one dim. So set 8 um^2 as lower limit
@@ -36,6 +111,12 @@ namespace gth818n
 
     m_meanshiftSigma = 20.0;
 
+    m_numberOfThreads = 1;
+
+    m_latticeMeanshift = false;
+
+    m_lightweightShapeAttributes = false;
+
     m_allDone = false;
 
     return;
@@ -54,10 +135,6 @@ namespace gth818n
 
     _computeConnectedComponentsLabelImage();
 
-    _computeLabelMap();
-
-    _computeObjectFeatures();
-
     _findObjectsToBreak();
 
     _breakRegion();
@@ -69,6 +146,8 @@ namespace gth818n
 
   void BinaryMaskAnalysisFilter::_findObjectsToBreak()
   {
+    _requestObjectAttributes(ObjectAreasAttribute | ObjectPerimetersAttribute);
+
     m_objectToBreak.assign( m_numberOfObjects, 0 ); ///< same as m_objectAreas.size()
 
     /*--------------------------------------------------------------------------------*/
@@ -115,6 +194,10 @@ namespace gth818n
             continue;
           }
 
+        /// Both the label map and LabelShapeAttributes2D give a Crofton
+        /// estimate of the physical perimeter: about 2 pi r on a disk of
+        /// radius r, so the measure is about 4 pi for a round object on
+        /// either path.
         if (measure > 30) ///< For COAD A6-2671, 10 is too low and break some single nucleus, 100 is too large and can't break some that should break
           {
             m_objectToBreak[objectId] = 1;
@@ -127,84 +210,145 @@ namespace gth818n
 
   void BinaryMaskAnalysisFilter::_breakRegion()
   {
-    typedef gth818n::HierarchicalMeanshiftClusteringFilter<float, 2> MeanshiftClusteringFilterType;
-
-    typedef MeanshiftClusteringFilterType::VectorType VectorType;
-    typedef itk::Statistics::ListSample< VectorType > SampleType;
+    if (std::find(m_objectToBreak.begin(), m_objectToBreak.end(), 1) == m_objectToBreak.end())
+      {
+        /// Nothing to break. The labels are already sorted by size, as
+        /// the relabeling below would give, and the attributes hold.
+        return;
+      }
 
     /// Step 10. Go through all labels, find ones that are larger than 400um^2
-    /// Step 20. Get all index of the region with this label, save as listSamples
-    //const itkLabelImageType::PixelType* m_connectedComponentLabelImageBufferPtr = m_connectedComponentLabelImage->GetBufferPointer();
-    //long numPixels = m_connectedComponentLabelImage->GetLargestPossibleRegion().GetNumberOfPixels();
-
+    /// Step 20. Get all index of the region with this label, from the
+    /// pixel runs of its label object
     long nx = m_connectedComponentLabelImage->GetLargestPossibleRegion().GetSize()[0];
-    long ny = m_connectedComponentLabelImage->GetLargestPossibleRegion().GetSize()[1];
-
-    std::vector<itkLabelImageType::PixelType> labelsWithLargeAreas;
-    std::vector<SampleType::Pointer> indexOfThatLabel;
-
-    itk2DIndexType idx;
-    VectorType idxVec;
 
     itkLabelImageType::PixelType currentLargestLabel = 0;
 
-    std::map<itkLabelImageType::PixelType, SampleType::Pointer> labelToIndexListMap;
+    std::vector<BreakRegionObject> objectsToBreak;
 
-    for (long iy = 0; iy < ny; ++iy)
+    if (m_lightweightShapeAttributes)
       {
-        idx[1] = iy;
-        idxVec[1] = static_cast<VectorType::ValueType>(iy);
-        for (long ix = 0; ix < nx; ++ix)
+        /// The labels are 1, ..., m_numberOfObjects. List the pixels of
+        /// each object to break by scanning its bounding box, in raster
+        /// order as the pixel runs of the label map. The objects to break
+        /// are few: this reads a small part of the label image.
+        const itkLabelImageType::PixelType* labelImageBufferPointer = m_connectedComponentLabelImage->GetBufferPointer();
+
+        currentLargestLabel = m_numberOfObjects;
+
+        for (unsigned int n = 0; n < m_numberOfObjects; ++n)
           {
-            idx[0] = ix;
-            idxVec[0] = static_cast<VectorType::ValueType>(ix);
+            if (1 != m_objectToBreak[n])
+              {
+                continue;
+              }
 
-            itkLabelImageType::PixelType thisLabel = m_connectedComponentLabelImage->GetPixel(idx);
-            currentLargestLabel = currentLargestLabel>thisLabel?currentLargestLabel:thisLabel;
+            objectsToBreak.push_back(BreakRegionObject());
+            BreakRegionObject& object = objectsToBreak.back();
 
-            if (thisLabel)
+            object.label = n + 1;
+            object.x.reserve(m_shapeAttributes.getNumberOfPixels()[n]);
+            object.y.reserve(m_shapeAttributes.getNumberOfPixels()[n]);
+
+            for (long iy = m_shapeAttributes.getYMin()[n]; iy <= m_shapeAttributes.getYMax()[n]; ++iy)
               {
-                long objectId = thisLabel - 1; ///< This "- 1" is the way the itkLabelImageToShapeLabelMapFilter works
-                if (1 == m_objectToBreak[objectId]  && labelToIndexListMap.find(thisLabel) == labelToIndexListMap.end() )
+                for (long ix = m_shapeAttributes.getXMin()[n]; ix <= m_shapeAttributes.getXMax()[n]; ++ix)
                   {
-                    labelToIndexListMap[thisLabel] = SampleType::New();
+                    if (labelImageBufferPointer[iy*nx + ix] == object.label)
+                      {
+                        object.x.push_back(static_cast<float>(ix));
+                        object.y.push_back(static_cast<float>(iy));
+                      }
                   }
-                else if (1 == m_objectToBreak[objectId] )
+              }
+          }
+      }
+    else
+      {
+        _requestObjectAttributes(ObjectPixelsAttribute);
+
+        for (unsigned int n = 0; n < m_numberOfObjects; ++n)
+          {
+            const ShapeLabelObjectType* labelObject = m_labelMap->GetNthLabelObject(n);
+
+            itkLabelImageType::PixelType thisLabel = labelObject->GetLabel();
+            currentLargestLabel = currentLargestLabel>thisLabel?currentLargestLabel:thisLabel;
+
+            long objectId = thisLabel - 1; ///< This "- 1" is the way the itkLabelImageToShapeLabelMapFilter works
+            if (1 != m_objectToBreak[objectId])
+              {
+                continue;
+              }
+
+            objectsToBreak.push_back(BreakRegionObject());
+            BreakRegionObject& object = objectsToBreak.back();
+
+            object.label = thisLabel;
+            object.x.reserve(labelObject->GetNumberOfPixels());
+            object.y.reserve(labelObject->GetNumberOfPixels());
+
+            for (unsigned long il = 0; il < labelObject->GetNumberOfLines(); ++il)
+              {
+                const ShapeLabelObjectType::LineType& line = labelObject->GetLine(il);
+                long ix0 = line.GetIndex()[0];
+                float y = static_cast<float>(line.GetIndex()[1]);
+
+                for (long ix = ix0; ix < ix0 + static_cast<long>(line.GetLength()); ++ix)
                   {
-                    labelToIndexListMap[thisLabel]->PushBack(idxVec);
+                    object.x.push_back(static_cast<float>(ix));
+                    object.y.push_back(y);
                   }
-              }// thisLabel != 0
-          }// ix
-      }// iy
+              }
+          }
+      }
 
 
     /// Step 30. Use mean shift to cluster those index
+    std::vector< std::vector<long> > labelsOfPoints(objectsToBreak.size());
+    std::vector<std::string> logs(objectsToBreak.size());
+
+    BreakRegionBody breakRegionBody(objectsToBreak, labelsOfPoints, logs, m_meanshiftSigma, m_latticeMeanshift);
+    if (1 == m_numberOfThreads)
+      {
+        for (std::size_t io = 0; io < objectsToBreak.size(); ++io)
+          {
+            breakRegionBody(cv::Range(static_cast<int>(io), static_cast<int>(io) + 1));
+            std::cout<<logs[io]<<std::flush;
+          }
+      }
+    else
+      {
+        /// n > 1 stripes: at most n objects at a time
+        cv::parallel_for_(cv::Range(0, static_cast<int>(objectsToBreak.size())), breakRegionBody,
+                          m_numberOfThreads > 1 ? m_numberOfThreads : -1);
+
+        for (std::size_t io = 0; io < objectsToBreak.size(); ++io)
+          {
+            std::cout<<logs[io]<<std::flush;
+          }
+      }
+
     /// Step 40. For each label, assign to the largest-current-label + 1, then largest-current-label add by 1
-    for (std::map<itkLabelImageType::PixelType, SampleType::Pointer>::iterator it = labelToIndexListMap.begin(); it != labelToIndexListMap.end(); ++it)
+    /// Done in the order of the labels, so the output does not depend on the threading
+    itkLabelImageType::PixelType* labelImageBufferPointer = m_connectedComponentLabelImage->GetBufferPointer();
+
+    for (std::size_t io = 0; io < objectsToBreak.size(); ++io)
       {
-        //dbg
-        std::cout<<"MS cluster "<<it->first<<" label. It has "<<it->second->Size()<<" points......... "<<std::flush;
-        //dbg, end
-        MeanshiftClusteringFilterType ms;
-        ms.setRadius(m_meanshiftSigma);
-        ms.setInputPointSet(it->second);
-        ms.update();
-        std::vector<long> label = ms.getLabelOfPoints();
+        const BreakRegionObject& object = objectsToBreak[io];
+        const std::vector<long>& label = labelsOfPoints[io];
         long maxLabel = label[0];
 
-        itk2DIndexType idx;
         for (std::size_t ip = 0; ip < label.size(); ++ip)
           {
-            idx[0] = static_cast<itk2DIndexType::IndexValueType>(it->second->GetMeasurementVector( ip )[0]);
-            idx[1] = static_cast<itk2DIndexType::IndexValueType>(it->second->GetMeasurementVector( ip )[1]);
+            long offset = static_cast<long>(object.y[ip])*nx + static_cast<long>(object.x[ip]);
 
             maxLabel = maxLabel>label[ip]?maxLabel:label[ip];
 
-            m_connectedComponentLabelImage->SetPixel(idx, 1 + label[ip] + currentLargestLabel);
+            labelImageBufferPointer[offset] = 1 + label[ip] + currentLargestLabel;
           }
 
         //dbg
-        std::cout<<" It has "<<maxLabel + 1<<" centers"<<std::endl<<std::flush;
+        std::cout<<"MS cluster "<<object.label<<" label has "<<maxLabel + 1<<" centers"<<std::endl<<std::flush;
         //dbg, end
 
         currentLargestLabel = currentLargestLabel + maxLabel + 1;
@@ -217,6 +361,11 @@ namespace gth818n
     relabelFilter->Update();
     m_connectedComponentLabelImage = relabelFilter->GetOutput();
 
+    /// The objects changed, their attributes are computed again on request
+    m_numberOfObjects = relabelFilter->GetNumberOfObjects();
+    m_availableAttributes = 0;
+    m_labelMap = 0;
+
     return;
   }
 
@@ -224,6 +373,17 @@ namespace gth818n
 
   void BinaryMaskAnalysisFilter::_colorObjectByFeature(unsigned char featureType)
   {
+    if (featureType == 1)
+      {
+        _requestObjectAttributes(ObjectAreasAttribute);
+      }
+    else if (featureType == 2)
+      {
+        _requestObjectAttributes(ObjectAreasAttribute | ObjectPerimetersAttribute);
+      }
+
+    m_featureColoredImageType = featureType;
+
     m_featureColoredImage = itkFloatImageType::New();
     m_featureColoredImage->SetRegions(m_binaryMask->GetLargestPossibleRegion() );
     m_featureColoredImage->Allocate();
@@ -288,7 +448,7 @@ namespace gth818n
         abort();
       }
 
-    if (!m_featureColoredImage)
+    if (!m_featureColoredImage || m_featureColoredImageType != featureType)
       {
         _colorObjectByFeature(featureType);
       }
@@ -297,17 +457,80 @@ namespace gth818n
   }
 
 
-  void BinaryMaskAnalysisFilter::_computeObjectFeatures()
+  void BinaryMaskAnalysisFilter::_requestObjectAttributes(unsigned int attributes)
+  {
+    unsigned int missingAttributes = attributes & ~m_availableAttributes;
+    if (0 == missingAttributes)
+      {
+        return;
+      }
+
+    if (m_lightweightShapeAttributes)
+      {
+        _computeShapeAttributes(missingAttributes);
+      }
+    else
+      {
+        _computeLabelMap(0 != (missingAttributes & ObjectPerimetersAttribute));
+      }
+
+    _computeObjectFeatures(missingAttributes);
+
+    m_availableAttributes |= missingAttributes;
+
+    return;
+  }
+
+
+  void BinaryMaskAnalysisFilter::_computeObjectFeatures(unsigned int attributes)
   {
     // std::cout << "File " << "\"" << fileName << "\""
     //           << " has " << labelMap->GetNumberOfLabelObjects() << " labels." << std::endl;
 
-    // Retrieve all attributes
-    m_objectAreas.resize(m_numberOfObjects);
-    m_objectPerimeters.resize(m_numberOfObjects);
-    m_objectEquivalentSphericalRadius.resize(m_numberOfObjects);
+    // Retrieve the requested attributes
+    bool doAreas = 0 != (attributes & ObjectAreasAttribute);
+    bool doPerimeters = 0 != (attributes & ObjectPerimetersAttribute);
+    bool doEquivalentSphericalRadius = 0 != (attributes & ObjectEquivalentSphericalRadiusAttribute);
+
+    if (doAreas)
+      {
+        m_objectAreas.resize(m_numberOfObjects);
+      }
+    if (doPerimeters)
+      {
+        m_objectPerimeters.resize(m_numberOfObjects);
+      }
+    if (doEquivalentSphericalRadius)
+      {
+        m_objectEquivalentSphericalRadius.resize(m_numberOfObjects);
+      }
     //m_objectNecessityOfBreaking.resize(m_numberOfObjects);
 
+    if (m_lightweightShapeAttributes)
+      {
+        for (unsigned int n = 0; n < m_numberOfObjects; ++n)
+          {
+            /// same as ShapeLabelObject: the physical size and the
+            /// radius of the disk of that size
+            double area = m_mpp*m_mpp*static_cast<double>(m_shapeAttributes.getNumberOfPixels()[n]);
+
+            if (doAreas)
+              {
+                m_objectAreas[n] = area;
+              }
+            if (doPerimeters)
+              {
+                m_objectPerimeters[n] = m_shapeAttributes.getPerimeters()[n];
+              }
+            if (doEquivalentSphericalRadius)
+              {
+                m_objectEquivalentSphericalRadius[n] = std::sqrt(area/vnl_math::pi);
+              }
+          }
+
+        return;
+      }
+
     for (unsigned int n = 0; n < m_numberOfObjects; ++n)
       {
         ShapeLabelObjectType *labelObject = m_labelMap->GetNthLabelObject(n);
@@ -318,10 +541,19 @@ namespace gth818n
         //           << labelObject->GetBoundingBox() << std::endl;
 
         //m_objectAreas[n] = m_mpp*m_mpp*static_cast<float>(labelObject->GetNumberOfPixels());
-        m_objectAreas[n] = labelObject->GetPhysicalSize();
+        if (doAreas)
+          {
+            m_objectAreas[n] = labelObject->GetPhysicalSize();
+          }
         //m_objectAreas[n] = static_cast<float>(labelObject->GetNumberOfPixels());
-        m_objectPerimeters[n]  = labelObject->GetPerimeter();
-        m_objectEquivalentSphericalRadius[n] = labelObject->GetEquivalentSphericalRadius();
+        if (doPerimeters)
+          {
+            m_objectPerimeters[n]  = labelObject->GetPerimeter();
+          }
+        if (doEquivalentSphericalRadius)
+          {
+            m_objectEquivalentSphericalRadius[n] = labelObject->GetEquivalentSphericalRadius();
+          }
         //m_objectNecessityOfBreaking[n] = m_objectPerimeters[n]*m_objectPerimeters[n]/m_objectAreas[n];
 
         // m_fileForOutputNucleusFeatures << labelObject->GetNumberOfPixels() << ",";
@@ -422,33 +654,73 @@ namespace gth818n
 
   void BinaryMaskAnalysisFilter::_computeConnectedComponentsLabelImage()
   {
-    typedef itk::ConnectedComponentImageFilter <itkBinaryMaskImageType, itkLabelImageType > ConnectedComponentImageFilterType;
-    ConnectedComponentImageFilterType::Pointer connected = ConnectedComponentImageFilterType::New ();
-    connected->SetInput(m_binaryMask);
-    connected->Update();
+    /// New objects: nothing computed for them yet
+    m_availableAttributes = 0;
+    m_labelMap = 0;
+    m_featureColoredImage = 0;
 
-    typedef itk::RelabelComponentImageFilter<itkLabelImageType, itkLabelImageType> FilterType;
-    FilterType::Pointer relabelFilter = FilterType::New();
-    relabelFilter->SetInput(connected->GetOutput());
-    //std::cout<<static_cast<FilterType::ObjectSizeType>(m_objectSizeThreshold/m_mpp/m_mpp)<<std::endl;
-    relabelFilter->SetMinimumObjectSize(static_cast<FilterType::ObjectSizeType>(m_objectSizeThreshold/m_mpp/m_mpp)); // This command takes number of pixels as input
-    relabelFilter->Update();
+    /// Same labels as ConnectedComponentImageFilter followed by
+    /// RelabelComponentImageFilter with a minimum object size, in the
+    /// label image buffer directly
+    m_connectedComponentLabelImage = itkLabelImageType::New();
+    m_connectedComponentLabelImage->SetRegions(m_binaryMask->GetLargestPossibleRegion());
+    m_connectedComponentLabelImage->Allocate();
+    m_connectedComponentLabelImage->CopyInformation(m_binaryMask);
 
-    m_connectedComponentLabelImage = relabelFilter->GetOutput();
+    itkBinaryMaskImageType::SizeType size = m_binaryMask->GetLargestPossibleRegion().GetSize();
+
+    nscale::ConnComponents cc;
+    m_numberOfObjects = cc.labelAreaOpening(m_binaryMask->GetBufferPointer(), size[0], size[1],
+                                            reinterpret_cast<int*>(m_connectedComponentLabelImage->GetBufferPointer()),
+                                            static_cast<int>(m_objectSizeThreshold/m_mpp/m_mpp), 4, true); // minimum size in number of pixels
 
     return;
   }
 
-  void BinaryMaskAnalysisFilter::_computeLabelMap()
+  void BinaryMaskAnalysisFilter::_computeLabelMap(bool computePerimeter)
   {
+    /// The label map has everything but the perimeter, which is the
+    /// costly part
+    if (m_labelMap && (m_labelMapHasPerimeter || !computePerimeter))
+      {
+        return;
+      }
+
     I2LType::Pointer i2l = I2LType::New();
     i2l->SetInput( m_connectedComponentLabelImage );
-    i2l->SetComputePerimeter(true);
+    i2l->SetComputePerimeter(computePerimeter);
     i2l->Update();
 
     m_labelMap = i2l->GetOutput();
+    m_labelMapHasPerimeter = computePerimeter;
+
+    return;
+  }
+
+  void BinaryMaskAnalysisFilter::_computeShapeAttributes(unsigned int attributes)
+  {
+    /// Only what the requested attributes need, in one scan of the
+    /// label image. The pixel counts come with every scan.
+    typedef LabelShapeAttributes2D<itkLabelImageType::PixelType> ShapeAttributesType;
+
+    if (0 == (attributes & ObjectPerimetersAttribute) && 0 != m_availableAttributes)
+      {
+        /// The pixel counts of the last scan are still those of the objects
+        return;
+      }
+
+    itkLabelImageType::SizeType size = m_connectedComponentLabelImage->GetLargestPossibleRegion().GetSize();
 
-    m_numberOfObjects = m_labelMap->GetNumberOfLabelObjects();
+    /// The bounding boxes are for _breakRegion, and cost next to nothing
+    unsigned int featureMask = ShapeAttributesType::NumberOfPixels | ShapeAttributesType::BoundingBox;
+    if (attributes & ObjectPerimetersAttribute)
+      {
+        featureMask |= ShapeAttributesType::Perimeter;
+      }
+
+    m_shapeAttributes.setFeatureMask(featureMask);
+    m_shapeAttributes.setSpacing(m_mpp);
+    m_shapeAttributes.compute(m_connectedComponentLabelImage->GetBufferPointer(), size[0], size[1], m_numberOfObjects);
 
     return;
   }
@@ -475,6 +747,8 @@ namespace gth818n
         abort();
       }
 
+    _requestObjectAttributes(ObjectAreasAttribute);
+
     return m_objectAreas;
   }
 
@@ -486,6 +760,8 @@ namespace gth818n
         abort();
       }
 
+    _requestObjectAttributes(ObjectPerimetersAttribute);
+
     return m_objectPerimeters;
   }
 
@@ -497,6 +773,8 @@ namespace gth818n
         abort();
       }
 
+    _requestObjectAttributes(ObjectEquivalentSphericalRadiusAttribute);
+
     return m_objectEquivalentSphericalRadius;
   }
 
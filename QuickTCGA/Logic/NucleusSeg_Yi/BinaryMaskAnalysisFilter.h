@@ -7,7 +7,8 @@
 #include "itkConnectedComponentImageFilter.h"
 #include "itkLabelImageToShapeLabelMapFilter.h"
 
-// // local
+// local
+#include "LabelShapeAttributes2D.h"
 // #include "itkTypedefs.h"
 
 
@@ -50,14 +51,20 @@ namespace gth818n
     void setObjectSizeThreshold(float sizeThld) {m_objectSizeThreshold = sizeThld;}
     void setObjectSizeUpperThreshold(float sizeUpperThld) {m_objectSizeUpperThreshold = sizeUpperThld;}
     void setMeanshiftSigma(float s) {m_meanshiftSigma = s;}
+    void setNumberOfThreads(int n) {m_numberOfThreads = n;} ///< 1 (default): break the objects one after another. n > 1: at most n at a time. <= 0: as many as OpenCV's threads. Same output and log in all cases
+    void setLatticeMeanshift(bool b) {m_latticeMeanshift = b;} ///< cluster with LatticeMeanshiftClusteringFilter (summed-area tables of the object) instead of HierarchicalMeanshiftClusteringFilter
+    void setLightweightShapeAttributes(bool b) {m_lightweightShapeAttributes = b;} ///< compute area and perimeter with LabelShapeAttributes2D instead of LabelImageToShapeLabelMapFilter
 
     void setMPP(float mpp);
 
-    itkFloatImageType::Pointer getFeatureColoredImage(unsigned char featureType);
+    itkFloatImageType::Pointer getFeatureColoredImage(unsigned char featureType); ///< 1: area, 2: perimeter^2/area
     itkLabelImageType::Pointer getConnectedComponentLabelImage();
 
     void update();
 
+    /// Attributes of the objects of getConnectedComponentLabelImage(),
+    /// the one of label l at l - 1. Computed on the first call only, so
+    /// a caller that needs only the labels does not pay for them.
     const std::vector<double>& getObjectAreas(); ///< mpp^2 * numberOfPixels where the numberOfPixels part does not respect image spcing (mpp)
     const std::vector<double>& getObjectPerimeters(); ///< spacing affects this in LabelImageToShapeLabelMapFilter
     const std::vector<double>& getObjectEquivalentSphericalRadius(); ///< spacing affects this in LabelImageToShapeLabelMapFilter
@@ -80,6 +87,15 @@ namespace gth818n
     typedef itk::LabelMap< ShapeLabelObjectType >         LabelMapType;
     typedef itk::LabelImageToShapeLabelMapFilter< itkLabelImageType, LabelMapType> I2LType;
 
+    /// Object attributes, as requested from _requestObjectAttributes
+    enum
+      {
+        ObjectAreasAttribute = 1,
+        ObjectPerimetersAttribute = 2,
+        ObjectEquivalentSphericalRadiusAttribute = 4,
+        ObjectPixelsAttribute = 8 ///< the pixel runs of the label map, for _breakRegion
+      };
+
 
     ////////////////////////////////////////////////////////////////////////////////
     /// private data
@@ -88,8 +104,12 @@ namespace gth818n
     itkLabelImageType::Pointer m_connectedComponentLabelImage;
 
     itkFloatImageType::Pointer m_featureColoredImage; ///< as the genearl output channel if want to color the object by some feature. So that we don't have to have separated "colorBySize", "colorBySizePerimeterRatio" etc.
+    unsigned char m_featureColoredImageType; ///< the featureType of m_featureColoredImage
 
     LabelMapType::Pointer m_labelMap;
+    bool m_labelMapHasPerimeter;
+
+    LabelShapeAttributes2D<itkLabelImageType::PixelType> m_shapeAttributes; ///< used instead of m_labelMap if m_lightweightShapeAttributes
 
     float m_mpp; ///< Micron Per Pixel
 
@@ -99,9 +119,16 @@ namespace gth818n
 
     float m_meanshiftSigma;
 
+    int m_numberOfThreads;
+
+    bool m_latticeMeanshift;
+
+    bool m_lightweightShapeAttributes;
+
 
-    /// computed features
+    /// computed features, of the objects of m_connectedComponentLabelImage
     unsigned int m_numberOfObjects; ///< I will use "Object" as well as "Connected Component"
+    unsigned int m_availableAttributes; ///< the attributes computed so far
     std::vector<double> m_objectAreas;
     std::vector<double> m_objectPerimeters;
     std::vector<double> m_objectEquivalentSphericalRadius;
@@ -118,8 +145,10 @@ namespace gth818n
     ////////////////////////////////////////////////////////////////////////////////
     /// private fn
     void _computeConnectedComponentsLabelImage();
-    void _computeLabelMap();
-    void _computeObjectFeatures();
+    void _requestObjectAttributes(unsigned int attributes); ///< compute those of the attributes not available yet
+    void _computeLabelMap(bool computePerimeter);
+    void _computeShapeAttributes(unsigned int attributes);
+    void _computeObjectFeatures(unsigned int attributes);
     void _findObjectsToBreak();
 
     //void _computeObjectNecessityOfBreakingValues();
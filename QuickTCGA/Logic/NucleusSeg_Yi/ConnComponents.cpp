@@ -6,6 +6,7 @@
  */
 #include "ConnComponents.h"
 #include <string.h>
+#include <algorithm>
 
 
 namespace nscale {
@@ -169,4 +170,135 @@ namespace nscale {
         return j;
     }
 
+    int ConnComponents::findSized(int *label, int x) {
+        int root = x;
+        while (label[root] > 0) {
+            root = label[root] - 1;
+        }
+
+        // Path compression
+        while (label[x] > 0 && label[x] - 1 != root) {
+            int next = label[x] - 1;
+            label[x] = root + 1;
+            x = next;
+        }
+
+        return root;
+    }
+
+    void ConnComponents::mergeSized(int *label, int x, int y) {
+        x = findSized(label, x);
+        y = findSized(label, y);
+
+        if (x == y) return;
+
+        // The earlier root stays the root, so parents are earlier pixels
+        if (x > y) std::swap(x, y);
+
+        label[x] += label[y];
+        label[y] = x + 1;
+    }
+
+    void ConnComponents::sizedUnionFind(const unsigned char *img, int w, int h, int *label, int connectivity) {
+        int i = -1, imw = 0;
+        unsigned char p;
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                ++i;
+                p = img[i];
+                if (p == 0) {
+                    label[i] = 0;
+                } else {
+                    label[i] = -1;
+                    imw = i - w;
+                    if (x > 0 && img[i - 1] != 0) mergeSized(label, i, i - 1);
+                    if (y > 0 && img[imw] != 0) mergeSized(label, i, imw);
+                    if (connectivity == 8) {
+                        if (y > 0 && x > 0 && img[imw - 1] != 0) mergeSized(label, i, imw - 1);
+                        if (y > 0 && x < w - 1 && img[imw + 1] != 0) mergeSized(label, i, imw + 1);
+                    }
+                }
+            }
+        }
+    }
+
+    int ConnComponents::resolveSized(int w, int h, int *label, int minSize, std::vector<int> &sizes) {
+        int length = w * h;
+        int n = 0;
+
+        sizes.clear();
+        for (int i = 0; i < length; ++i) {
+            int v = label[i];
+            if (v < 0) {
+                // Root, i.e. first pixel of its component: the size is known
+                if (-v >= minSize) {
+                    label[i] = ++n;
+                    sizes.push_back(-v);
+                } else {
+                    label[i] = 0;
+                }
+            } else if (v > 0) {
+                // The parent is an earlier pixel, already final
+                label[i] = label[v - 1];
+            }
+        }
+
+        return n;
+    }
+
+    /**
+     * Replaces label + areaThresholdLabeled + relabel, as well as
+     * itk::ConnectedComponentImageFilter + itk::RelabelComponentImageFilter
+     * with a minimum object size: two raster passes over the image, no
+     * intermediate images or maps. A third pass if sortBySize.
+     */
+    int ConnComponents::labelAreaOpening(const unsigned char *img, int w, int h, int *label, int minSize, int connectivity, bool sortBySize) {
+        sizedUnionFind(img, w, h, label, connectivity);
+
+        std::vector<int> sizes;
+        int n = resolveSized(w, h, label, minSize, sizes);
+
+        if (sortBySize && n > 1) {
+            // Same order as itk::RelabelComponentImageFilter
+            std::vector<std::pair<int, int> > order(n);
+            for (int j = 0; j < n; ++j) {
+                order[j] = std::make_pair(-sizes[j], j);
+            }
+            std::sort(order.begin(), order.end());
+
+            std::vector<int> newLabel(n + 1, 0);
+            for (int j = 0; j < n; ++j) {
+                newLabel[order[j].second + 1] = j + 1;
+            }
+
+            int length = w * h;
+            for (int i = 0; i < length; ++i) {
+                label[i] = newLabel[label[i]];
+            }
+        }
+
+        return n;
+    }
+
+    int ConnComponents::maskAreaOpening(unsigned char *img, int w, int h, int *label, int minSize, int connectivity) {
+        sizedUnionFind(img, w, h, label, connectivity);
+
+        int length = w * h;
+        int n = 0;
+
+        // resolveSized, writing img on the way
+        for (int i = 0; i < length; ++i) {
+            int v = label[i];
+            if (v < 0) {
+                label[i] = -v >= minSize ? ++n : 0;
+            } else if (v > 0) {
+                label[i] = label[v - 1];
+            }
+            img[i] = label[i] > 0 ? 1 : 0;
+        }
+
+        return n;
+    }
+
+
 }
@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 #if(_MSC_VER == 1800)
 #include <unordered_map>
@@ -49,6 +50,17 @@ namespace nscale {
         int relabel(int w, int h, int *label, int bgval);
 
         int areaThresholdLabeled(const int *label, const int w, const int h, int *n_label, const int bgval, const int lower, const int upper);
+
+        // Fused connected components, size filter and relabel: components of
+        // at least minSize pixels get labels 1..n in the order of their first
+        // pixel (or by decreasing size, ties in that order, if sortBySize), the
+        // rest 0. Returns n.
+        int labelAreaOpening(const unsigned char *img, int w, int h, int *label, int minSize, int connectivity, bool sortBySize);
+
+        // Same, writing the binary mask of the kept components back to img.
+        // label is only work space.
+        int maskAreaOpening(unsigned char *img, int w, int h, int *label, int minSize, int connectivity);
+
         // not using:
         // int *boundingBox(const int w, const int h, const int *label, int bgval, int &compcount);
 
@@ -61,6 +73,19 @@ namespace nscale {
 
         int flatten(int *label, int x, int bgval);
 
+        // Union-find for labelAreaOpening and maskAreaOpening, in label itself:
+        // 0 background, -size at a root, parent + 1 elsewhere. Parents are
+        // always earlier pixels.
+        void sizedUnionFind(const unsigned char *img, int w, int h, int *label, int connectivity);
+
+        int findSized(int *label, int x);
+
+        void mergeSized(int *label, int x, int y);
+
+        // Second raster pass: replace the union-find by the final labels.
+        // Returns the number of components kept.
+        int resolveSized(int w, int h, int *label, int minSize, std::vector<int> &sizes);
+
     };
 
 }
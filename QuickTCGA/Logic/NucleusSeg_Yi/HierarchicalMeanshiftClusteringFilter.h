@@ -2,6 +2,7 @@
 #define HierarchicalMeanshiftClusteringFilter_h_
 
 #include <sstream>
+#include <vector>
 
 // itk
 #include "itkVector.h"
@@ -52,11 +53,13 @@ namespace gth818n
     static unsigned int GetPointDimension() { return m_PointDimension; }
 
     void setInputPointSet(typename VectorSampleType::Pointer inputPointSet) {m_inputPointSet = inputPointSet;}
+    void setInputPoints(const TCoordRep* x, const TCoordRep* y, long n); ///< 2D only, see MeanshiftClusteringFilter::setInputPoints
     void setRadius(RealType rad);
     void setSubsampleRatio(RealType ratio);
     void update();
 
     typename VectorSampleType::Pointer getCenters();
+    void getCenters(std::vector<TCoordRep>& x, std::vector<TCoordRep>& y); ///< 2D only
     std::vector<long> getLabelOfPoints();
     /// public fn, end
     //------------------------------------------------------------------------------
@@ -70,6 +73,13 @@ namespace gth818n
     typename VectorSampleType::Pointer m_inputPointSet;
     typename VectorSampleType::Pointer m_centers;
 
+    /// For NPointDimension == 2, the points and centers are in these
+    /// flat arrays, instead of ListSample's
+    std::vector<TCoordRep> m_inputX;
+    std::vector<TCoordRep> m_inputY;
+    std::vector<TCoordRep> m_centerX;
+    std::vector<TCoordRep> m_centerY;
+
     RealType m_radius;
 
     RealType m_subsampleRatio;
@@ -88,6 +98,8 @@ namespace gth818n
     void _runMeanshiftOnSubsample();
     void _getLabelFromResultsOfSubsample();
     void _computeOptimalSubSampleRatio();
+    long _numberOfInputPoints() const;
+    void _update2D();
     /// private fn
     //------------------------------------------------------------------------------
   };
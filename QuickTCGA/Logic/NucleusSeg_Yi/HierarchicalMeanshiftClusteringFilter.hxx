@@ -1,11 +1,14 @@
 #ifndef HierarchicalMeanshiftClusteringFilter_hxx_
 #define HierarchicalMeanshiftClusteringFilter_hxx_
 
+#include <cmath>
+
 #include "itkNumericTraits.h"
 #include "vnl/vnl_random.h"
 
 #include "HierarchicalMeanshiftClusteringFilter.h"
 #include "MeanshiftClusteringFilter.h"
+#include "PointGrid2D.h"
 
 namespace gth818n
 {
@@ -39,7 +42,7 @@ namespace gth818n
   template< typename TCoordRep, unsigned int NPointDimension >
   int HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::_prepareForRun()
   {
-    if (0 == m_inputPointSet->Size())
+    if (0 == _numberOfInputPoints())
       {
         m_outputStream<<"Error: means shift input point set is empty.\n";
         abort();
@@ -62,13 +65,13 @@ namespace gth818n
   void HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::_computeOptimalSubSampleRatio()
   {
     /// find a m_subsampleRatio so that there are 1000 points for mean shift
-    if (m_inputPointSet->Size() <= 1000)
+    if (_numberOfInputPoints() <= 1000)
       {
         m_subsampleRatio = 1.0;
       }
     else
       {
-        m_subsampleRatio = 1000.0/static_cast<double>(m_inputPointSet->Size());
+        m_subsampleRatio = 1000.0/static_cast<double>(_numberOfInputPoints());
       }
 
     return;
@@ -76,6 +79,31 @@ namespace gth818n
 
 
 
+  template< typename TCoordRep, unsigned int NPointDimension >
+  long HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::_numberOfInputPoints() const
+  {
+    return m_inputPointSet ? static_cast<long>(m_inputPointSet->Size()) : static_cast<long>(m_inputX.size());
+  }
+
+
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::setInputPoints(const TCoordRep* x, const TCoordRep* y, long n)
+  {
+    if (2 != NPointDimension)
+      {
+        m_outputStream<<"Error: setInputPoints is for 2D points only.\n";
+        abort();
+      }
+
+    m_inputPointSet = 0;
+
+    m_inputX.assign(x, x + n);
+    m_inputY.assign(y, y + n);
+
+    return;
+  }
+
+
   template< typename TCoordRep, unsigned int NPointDimension >
   void HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::update()
   {
@@ -84,10 +112,19 @@ namespace gth818n
     _prepareForRun();
 
     m_outputStream<<"In HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::update(), before sub-sampling\n"<<std::flush;
-    std::cout<<"In HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::update(), before sub-sampling\n"<<std::flush;
     m_outputStream<<"m_subsampleRatio = "<<m_subsampleRatio<<std::endl<<std::flush;
-    std::cout<<"m_subsampleRatio = "<<m_subsampleRatio<<std::endl<<std::flush;
-    
+
+    if (2 == NPointDimension)
+      {
+        _update2D();
+
+        m_outputStream<<"done with hierachical mean shift\n"<<std::flush;
+
+        m_allDone = true;
+
+        return;
+      }
+
     /// Sub-sample input point set
     typename VectorSampleType::Pointer subsample = VectorSampleType::New();
 
@@ -104,7 +141,6 @@ namespace gth818n
       }
 
     m_outputStream<<"before mean shift\n"<<std::flush;
-    std::cout<<"before mean shift\n"<<std::flush;
 
     /// Run mean shift on sub-sample
     typedef gth818n::MeanshiftClusteringFilter<TCoordRep, NPointDimension> MeanshiftClusteringFilterType;
@@ -114,7 +150,6 @@ namespace gth818n
     ms.update();
 
     m_outputStream<<"after mean shift\n"<<std::flush;
-    std::cout<<"after mean shift\n"<<std::flush;
 
 
     /// Get label back to input point set by closest point criteria
@@ -146,7 +181,6 @@ namespace gth818n
 
 
     m_outputStream<<"done with hierachical mean shift\n"<<std::flush;
-    std::cout<<"done with hierachical mean shift\n"<<std::flush;
 
 
     m_allDone = true;
@@ -154,6 +188,83 @@ namespace gth818n
     return;
   }
 
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::_update2D()
+  {
+    if (m_inputPointSet)
+      {
+        /// ListSample input: copy it to the flat arrays once
+        long n = m_inputPointSet->Size();
+
+        m_inputX.resize(n);
+        m_inputY.resize(n);
+
+        for (long i = 0; i < n; ++i)
+          {
+            const VectorType& thisPoint = m_inputPointSet->GetMeasurementVector(i);
+            m_inputX[i] = thisPoint[0];
+            m_inputY[i] = thisPoint[1];
+          }
+      }
+
+    long n = m_inputX.size();
+
+    /// Sub-sample input point set, same draws as update()
+    std::vector<TCoordRep> subsampleX(1, m_inputX[0]); ///< so the subsample is never empty.
+    std::vector<TCoordRep> subsampleY(1, m_inputY[0]);
+
+    vnl_random rg;
+    rg.reseed(1);
+    for (long i = 1 ; i < n ; ++i ) ///< since 0-th has been pushed in, here start with 1
+      {
+        if (rg.drand64() <= m_subsampleRatio)
+          {
+            subsampleX.push_back(m_inputX[i]);
+            subsampleY.push_back(m_inputY[i]);
+          }
+      }
+
+    /// Run mean shift on sub-sample
+    typedef gth818n::MeanshiftClusteringFilter<TCoordRep, NPointDimension> MeanshiftClusteringFilterType;
+    MeanshiftClusteringFilterType ms;
+    ms.setInputPoints(&subsampleX[0], &subsampleY[0], subsampleX.size());
+    ms.setRadius(m_radius);
+    ms.update();
+
+    std::vector<long> sublabel = ms.getLabelOfPoints();
+    ms.getCenters(m_centerX, m_centerY);
+    m_centers = 0;
+
+    /// Get label back to input point set by closest point criteria:
+    /// the sub-sample is bucketed in cells holding about one point
+    TCoordRep xMin = subsampleX[0];
+    TCoordRep xMax = subsampleX[0];
+    TCoordRep yMin = subsampleY[0];
+    TCoordRep yMax = subsampleY[0];
+
+    for (std::size_t i = 1; i < subsampleX.size(); ++i)
+      {
+        xMin = xMin<subsampleX[i]?xMin:subsampleX[i];
+        xMax = xMax>subsampleX[i]?xMax:subsampleX[i];
+        yMin = yMin<subsampleY[i]?yMin:subsampleY[i];
+        yMax = yMax>subsampleY[i]?yMax:subsampleY[i];
+      }
+
+    double cellSize = std::sqrt((xMax - xMin + 1.0)*(yMax - yMin + 1.0)/static_cast<double>(subsampleX.size()));
+
+    PointGrid2D<TCoordRep> subsampleGrid;
+    subsampleGrid.build(&subsampleX[0], &subsampleY[0], subsampleX.size(), cellSize);
+
+    m_labelOfPoints.resize(n);
+
+    for (long i = 0 ; i < n ; ++i )
+      {
+        m_labelOfPoints[i] = sublabel[subsampleGrid.nearestPoint(m_inputX[i], m_inputY[i])];
+      }
+
+    return;
+  }
+
   template< typename TCoordRep, unsigned int NPointDimension >
   void HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::setRadius(RealType rad)
   {
@@ -192,10 +303,44 @@ namespace gth818n
         m_outputStream<<"Error: not done.\n";
       }
 
+    if (2 == NPointDimension && !m_centers)
+      {
+        m_centers = VectorSampleType::New();
+
+        VectorType center;
+        for (std::size_t ic = 0; ic < m_centerX.size(); ++ic)
+          {
+            center[0] = m_centerX[ic];
+            center[1] = m_centerY[ic];
+            m_centers->PushBack(center);
+          }
+      }
+
     return m_centers;
   }
 
 
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::getCenters(std::vector<TCoordRep>& x, std::vector<TCoordRep>& y)
+  {
+    if (!m_allDone)
+      {
+        m_outputStream<<"Error: not done.\n";
+      }
+
+    if (2 != NPointDimension)
+      {
+        m_outputStream<<"Error: getCenters(x, y) is for 2D points only.\n";
+        abort();
+      }
+
+    x = m_centerX;
+    y = m_centerY;
+
+    return;
+  }
+
+
   template< typename TCoordRep, unsigned int NPointDimension >
   std::vector<long>
   HierarchicalMeanshiftClusteringFilter<TCoordRep, NPointDimension>::getLabelOfPoints()
@@ -0,0 +1,250 @@
+#ifndef LabelShapeAttributes2D_h_
+#define LabelShapeAttributes2D_h_
+
+#include <cmath>
+#include <vector>
+
+#include "vnl/vnl_math.h"
+
+
+namespace gth818n
+{
+  /**
+   * Shape attributes of the objects of a label image, accumulated in
+   * one raster scan.
+   *
+   * The labels are 1, ..., numberOfLabels, 0 being the background, as
+   * given by itk::RelabelComponentImageFilter. The attributes of label
+   * l are at index l - 1, as for the n-th label object of
+   * itk::LabelImageToShapeLabelMapFilter.
+   *
+   * Only the attributes in the feature mask are computed. This is
+   * meant for the few attributes needed per object in a tile; the full
+   * set is still in itk::LabelImageToShapeLabelMapFilter.
+   */
+  template< typename TLabel >
+  class LabelShapeAttributes2D
+  {
+  public:
+    //------------------------------------------------------------------------------
+    /// feature mask
+    enum
+      {
+        NumberOfPixels = 1,
+        BoundingBox = 2,
+        Centroid = 4,
+        Perimeter = 8, ///< Crofton formula with 4 directions
+        AllAttributes = 15
+      };
+    /// feature mask, end
+    //------------------------------------------------------------------------------
+
+
+    //------------------------------------------------------------------------------
+    /// ctor
+    LabelShapeAttributes2D();
+    ~LabelShapeAttributes2D() {}
+    /// ctor, end
+    //------------------------------------------------------------------------------
+
+
+    //------------------------------------------------------------------------------
+    /// public fn
+    void setFeatureMask(unsigned int mask) {m_featureMask = mask;}
+    void setSpacing(double spacing) {m_spacing = spacing;} ///< isotropic; scales the centroid and the perimeter
+
+    /// Scan the nx x ny label image, stored row by row
+    void compute(const TLabel* labels, long nx, long ny, long numberOfLabels);
+
+    long getNumberOfLabels() const {return m_numberOfLabels;}
+
+    const std::vector<long>& getNumberOfPixels() const {return m_numberOfPixels;}
+    const std::vector<double>& getPerimeters() const {return m_perimeters;}
+
+    /// Centroid in physical coordinates (origin 0)
+    const std::vector<double>& getCentroidX() const {return m_centroidX;}
+    const std::vector<double>& getCentroidY() const {return m_centroidY;}
+
+    /// Bounding box [xMin, xMax] x [yMin, yMax] in pixels
+    const std::vector<long>& getXMin() const {return m_xMin;}
+    const std::vector<long>& getXMax() const {return m_xMax;}
+    const std::vector<long>& getYMin() const {return m_yMin;}
+    const std::vector<long>& getYMax() const {return m_yMax;}
+
+    /// Boundary crossings, along the axes and along the diagonals, of
+    /// the lines through pixel ix of row, which is in the object
+    /// row[ix]. rowAbove and rowBelow are 0 at the image border.
+    static void countIntercepts(const TLabel* row, const TLabel* rowAbove, const TLabel* rowBelow, long ix, long nx,
+                                long& axesIntercepts, long& diagonalIntercepts);
+
+    /// Crofton perimeter from the sums of countIntercepts of an object
+    static double croftonPerimeter(long axesIntercepts, long diagonalIntercepts, double spacing);
+    /// public fn, end
+    //------------------------------------------------------------------------------
+
+
+  private:
+    unsigned int m_featureMask;
+    double m_spacing;
+
+    long m_numberOfLabels;
+
+    std::vector<long> m_numberOfPixels;
+    std::vector<double> m_perimeters;
+    std::vector<double> m_centroidX;
+    std::vector<double> m_centroidY;
+    std::vector<long> m_xMin;
+    std::vector<long> m_xMax;
+    std::vector<long> m_yMin;
+    std::vector<long> m_yMax;
+
+    /// number of boundary crossings along the x and y lines, and along
+    /// the (1, 1) and (1, -1) lines
+    std::vector<long> m_axesIntercepts;
+    std::vector<long> m_diagonalIntercepts;
+  };
+
+
+  template< typename TLabel >
+  LabelShapeAttributes2D<TLabel>::LabelShapeAttributes2D()
+  {
+    m_featureMask = AllAttributes;
+    m_spacing = 1.0;
+    m_numberOfLabels = 0;
+  }
+
+
+  template< typename TLabel >
+  void LabelShapeAttributes2D<TLabel>::compute(const TLabel* labels, long nx, long ny, long numberOfLabels)
+  {
+    m_numberOfLabels = numberOfLabels;
+
+    bool doBoundingBox = (m_featureMask & BoundingBox) != 0;
+    bool doCentroid = (m_featureMask & Centroid) != 0;
+    bool doPerimeter = (m_featureMask & Perimeter) != 0;
+
+    /// The pixel count is needed by the centroid anyway
+    m_numberOfPixels.assign(numberOfLabels, 0);
+
+    if (doBoundingBox)
+      {
+        m_xMin.assign(numberOfLabels, nx);
+        m_xMax.assign(numberOfLabels, -1);
+        m_yMin.assign(numberOfLabels, ny);
+        m_yMax.assign(numberOfLabels, -1);
+      }
+
+    std::vector<double> sumX;
+    std::vector<double> sumY;
+    if (doCentroid)
+      {
+        sumX.assign(numberOfLabels, 0.0);
+        sumY.assign(numberOfLabels, 0.0);
+      }
+
+    if (doPerimeter)
+      {
+        m_axesIntercepts.assign(numberOfLabels, 0);
+        m_diagonalIntercepts.assign(numberOfLabels, 0);
+      }
+
+    for (long iy = 0; iy < ny; ++iy)
+      {
+        const TLabel* row = labels + iy*nx;
+        const TLabel* rowAbove = iy > 0 ? row - nx : 0;
+        const TLabel* rowBelow = iy < ny - 1 ? row + nx : 0;
+
+        for (long ix = 0; ix < nx; ++ix)
+          {
+            TLabel l = row[ix];
+            if (0 == l)
+              {
+                continue;
+              }
+
+            long id = static_cast<long>(l) - 1;
+
+            ++m_numberOfPixels[id];
+
+            if (doBoundingBox)
+              {
+                m_xMin[id] = m_xMin[id]<ix?m_xMin[id]:ix;
+                m_xMax[id] = m_xMax[id]>ix?m_xMax[id]:ix;
+                m_yMin[id] = m_yMin[id]<iy?m_yMin[id]:iy;
+                m_yMax[id] = m_yMax[id]>iy?m_yMax[id]:iy;
+              }
+
+            if (doCentroid)
+              {
+                sumX[id] += ix;
+                sumY[id] += iy;
+              }
+
+            if (doPerimeter)
+              {
+                countIntercepts(row, rowAbove, rowBelow, ix, nx, m_axesIntercepts[id], m_diagonalIntercepts[id]);
+              }
+          }
+      }
+
+    if (doCentroid)
+      {
+        m_centroidX.resize(numberOfLabels);
+        m_centroidY.resize(numberOfLabels);
+
+        for (long id = 0; id < numberOfLabels; ++id)
+          {
+            double n = m_numberOfPixels[id] > 0 ? static_cast<double>(m_numberOfPixels[id]) : 1.0;
+            m_centroidX[id] = m_spacing*sumX[id]/n;
+            m_centroidY[id] = m_spacing*sumY[id]/n;
+          }
+      }
+
+    if (doPerimeter)
+      {
+        m_perimeters.resize(numberOfLabels);
+
+        for (long id = 0; id < numberOfLabels; ++id)
+          {
+            m_perimeters[id] = croftonPerimeter(m_axesIntercepts[id], m_diagonalIntercepts[id], m_spacing);
+          }
+      }
+
+    return;
+  }
+
+  template< typename TLabel >
+  void LabelShapeAttributes2D<TLabel>::countIntercepts(const TLabel* row, const TLabel* rowAbove, const TLabel* rowBelow, long ix, long nx,
+                                                       long& axesIntercepts, long& diagonalIntercepts)
+  {
+    /// A line of each direction crosses the boundary between this pixel
+    /// and its neighbor if the neighbor is not in the object. Outside of
+    /// the image is background.
+    TLabel l = row[ix];
+
+    bool hasLeft = ix > 0;
+    bool hasRight = ix < nx - 1;
+
+    axesIntercepts += (!hasLeft || row[ix - 1] != l) + (!hasRight || row[ix + 1] != l);
+    axesIntercepts += (!rowAbove || rowAbove[ix] != l) + (!rowBelow || rowBelow[ix] != l);
+
+    diagonalIntercepts += (!rowAbove || !hasLeft || rowAbove[ix - 1] != l) + (!rowBelow || !hasRight || rowBelow[ix + 1] != l);
+    diagonalIntercepts += (!rowBelow || !hasLeft || rowBelow[ix - 1] != l) + (!rowAbove || !hasRight || rowAbove[ix + 1] != l);
+
+    return;
+  }
+
+
+  template< typename TLabel >
+  double LabelShapeAttributes2D<TLabel>::croftonPerimeter(long axesIntercepts, long diagonalIntercepts, double spacing)
+  {
+    /// P = pi/2 * sum_d w_d * s_d * N_d, with the 4 directions of equal
+    /// weight w_d = 1/4, N_d the number of crossings along direction d
+    /// and s_d the distance between two lines of that direction: spacing
+    /// for the axes, spacing/sqrt(2) for the diagonals.
+    return vnl_math::pi/8.0*spacing*(static_cast<double>(axesIntercepts) + static_cast<double>(diagonalIntercepts)/std::sqrt(2.0));
+  }
+
+}// namespace gth818n
+
+#endif // LabelShapeAttributes2D_h_
@@ -0,0 +1,120 @@
+#ifndef LatticeMeanshiftClusteringFilter_h_
+#define LatticeMeanshiftClusteringFilter_h_
+
+#include <vector>
+
+// itk
+#include "itkVector.h"
+#include "itkListSample.h"
+
+// local
+#include "PointGrid2D.h"
+
+
+namespace gth818n
+{
+  /**
+   * Mean shift of the pixels of a 2D binary object, with a flat kernel.
+   *
+   * The input points are the (integer) pixel coordinates of the
+   * object. The neighbors of a seed are the object pixels in a square
+   * window around it, so the count and the coordinate sums of the
+   * neighbors come from three summed-area tables of the object mask in
+   * O(1), instead of from a tree or grid search. The window has the
+   * same area as the disk of radius m_radius.
+   *
+   * Same interface and outputs as MeanshiftClusteringFilter, for 2D.
+   */
+  template< typename TCoordRep >
+  class LatticeMeanshiftClusteringFilter
+  {
+  public:
+    //------------------------------------------------------------------------------
+    /// typedef
+    typedef LatticeMeanshiftClusteringFilter Self;
+
+    typedef TCoordRep ValueType;
+    typedef TCoordRep CoordRepType;
+
+    typedef double RealType;
+
+    typedef itk::Vector< TCoordRep, 2 > VectorType;
+
+    typedef typename itk::Statistics::ListSample< VectorType > VectorSampleType;
+    /// typedef, end
+    //------------------------------------------------------------------------------
+
+
+    //------------------------------------------------------------------------------
+    /// ctor
+    LatticeMeanshiftClusteringFilter();
+    ~LatticeMeanshiftClusteringFilter() {}
+    /// ctor, end
+    //------------------------------------------------------------------------------
+
+
+    //------------------------------------------------------------------------------
+    /// public fn
+    void setInputPointSet(typename VectorSampleType::Pointer inputPointSet) {m_inputPointSet = inputPointSet;}
+    void setInputPoints(const TCoordRep* x, const TCoordRep* y, long n); ///< not copied, must stay valid until update() returns
+    void setRadius(RealType rad);
+    void update();
+
+    typename VectorSampleType::Pointer getCenters();
+    std::vector<long> getLabelOfPoints();
+    /// public fn, end
+    //------------------------------------------------------------------------------
+
+
+  private:
+    typename VectorSampleType::Pointer m_inputPointSet;
+    typename VectorSampleType::Pointer m_centers;
+
+    /// input of setInputPoints, used when m_inputPointSet is not set
+    const TCoordRep* m_inputX;
+    const TCoordRep* m_inputY;
+    long m_numberOfInputPoints;
+
+    RealType m_radius;
+    long m_numberOfMSIteration;
+    RealType m_convergenceThreshold; ///< a seed has converged when it moves less than this times m_radius in one iteration
+
+    /// bounding box of the input points
+    long m_xMin;
+    long m_yMin;
+    long m_nx;
+    long m_ny;
+
+    /// summed-area tables, (m_nx + 1) x (m_ny + 1), of the mask and of
+    /// the x and y coordinates (relative to m_xMin, m_yMin) of its pixels
+    std::vector<long> m_countTable;
+    std::vector<double> m_sumXTable;
+    std::vector<double> m_sumYTable;
+
+    std::vector<double> m_seedX;
+    std::vector<double> m_seedY;
+
+    CenterGrid2D<double> m_centerGrid;
+
+    std::vector<long> m_labelOfPoints;
+
+    bool m_allDone;
+    /// private data, end
+    //------------------------------------------------------------------------------
+
+
+    //------------------------------------------------------------------------------
+    /// private fn
+    void _constructSummedAreaTables();
+    void _meanshiftIteration();
+    void _findUniqueCenters();
+    void _findLabelOfPoints();
+    /// private fn
+    //------------------------------------------------------------------------------
+  };
+
+}// namespace gth818n
+
+#include "LatticeMeanshiftClusteringFilter.hxx"
+
+#endif // LatticeMeanshiftClusteringFilter_h_
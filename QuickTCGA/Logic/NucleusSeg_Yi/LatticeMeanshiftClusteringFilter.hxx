@@ -0,0 +1,331 @@
+#ifndef LatticeMeanshiftClusteringFilter_hxx_
+#define LatticeMeanshiftClusteringFilter_hxx_
+
+#include <cmath>
+
+#include "itkNumericTraits.h"
+#include "vnl/vnl_math.h"
+
+#include "LatticeMeanshiftClusteringFilter.h"
+
+
+namespace gth818n
+{
+
+  template< typename TCoordRep >
+  LatticeMeanshiftClusteringFilter<TCoordRep>::LatticeMeanshiftClusteringFilter()
+  {
+    m_inputPointSet = 0;
+
+    m_inputX = 0;
+    m_inputY = 0;
+    m_numberOfInputPoints = 0;
+
+    m_numberOfMSIteration = 100;
+    m_convergenceThreshold = 1e-3;
+
+    m_radius = 3.0;
+
+    m_xMin = 0;
+    m_yMin = 0;
+    m_nx = 0;
+    m_ny = 0;
+
+    m_allDone = false;
+  }
+
+
+  template< typename TCoordRep >
+  void LatticeMeanshiftClusteringFilter<TCoordRep>::update()
+  {
+    if (m_inputPointSet)
+      {
+        m_numberOfInputPoints = m_inputPointSet->Size();
+      }
+
+    if (0 == m_numberOfInputPoints)
+      {
+        std::cerr<<"Error: means shift input point set is empty.\n";
+        abort();
+      }
+
+    _constructSummedAreaTables();
+
+    _meanshiftIteration();
+
+    _findUniqueCenters();
+
+    _findLabelOfPoints();
+
+    m_allDone = true;
+
+    return;
+  }
+
+  template< typename TCoordRep >
+  void LatticeMeanshiftClusteringFilter<TCoordRep>::setInputPoints(const TCoordRep* x, const TCoordRep* y, long n)
+  {
+    m_inputPointSet = 0;
+
+    m_inputX = x;
+    m_inputY = y;
+    m_numberOfInputPoints = n;
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  void LatticeMeanshiftClusteringFilter<TCoordRep>::setRadius(RealType rad)
+  {
+    if (rad <= 0.0)
+      {
+        std::cerr<<"Error: rad should > 0, but got "<<rad<<std::endl;
+        abort();
+      }
+
+    m_radius = rad;
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  void LatticeMeanshiftClusteringFilter<TCoordRep>::_constructSummedAreaTables()
+  {
+    long n = m_numberOfInputPoints;
+
+    std::vector<long> x(n);
+    std::vector<long> y(n);
+
+    if (m_inputPointSet)
+      {
+        for (long i = 0; i < n; ++i)
+          {
+            const VectorType& thisPoint = m_inputPointSet->GetMeasurementVector(i);
+            x[i] = static_cast<long>(std::floor(thisPoint[0] + 0.5));
+            y[i] = static_cast<long>(std::floor(thisPoint[1] + 0.5));
+          }
+      }
+    else
+      {
+        for (long i = 0; i < n; ++i)
+          {
+            x[i] = static_cast<long>(std::floor(m_inputX[i] + 0.5));
+            y[i] = static_cast<long>(std::floor(m_inputY[i] + 0.5));
+          }
+      }
+
+    m_xMin = x[0];
+    m_yMin = y[0];
+    long xMax = x[0];
+    long yMax = y[0];
+
+    for (long i = 1; i < n; ++i)
+      {
+        m_xMin = m_xMin<x[i]?m_xMin:x[i];
+        m_yMin = m_yMin<y[i]?m_yMin:y[i];
+        xMax = xMax>x[i]?xMax:x[i];
+        yMax = yMax>y[i]?yMax:y[i];
+      }
+
+    m_nx = xMax - m_xMin + 1;
+    m_ny = yMax - m_yMin + 1;
+
+    /// table (ix + 1, iy + 1) sums the pixels in [0, ix] x [0, iy], so
+    /// row 0 and column 0 are 0
+    long tableNx = m_nx + 1;
+    long tableSize = tableNx*(m_ny + 1);
+
+    m_countTable.assign(tableSize, 0);
+    m_sumXTable.assign(tableSize, 0.0);
+    m_sumYTable.assign(tableSize, 0.0);
+
+    for (long i = 0; i < n; ++i)
+      {
+        long ix = x[i] - m_xMin;
+        long iy = y[i] - m_yMin;
+        long t = (iy + 1)*tableNx + ix + 1;
+
+        m_countTable[t] = 1;
+        m_sumXTable[t] = static_cast<double>(ix);
+        m_sumYTable[t] = static_cast<double>(iy);
+      }
+
+    for (long iy = 1; iy <= m_ny; ++iy)
+      {
+        long rowCount = 0;
+        double rowSumX = 0.0;
+        double rowSumY = 0.0;
+
+        for (long ix = 1; ix <= m_nx; ++ix)
+          {
+            long t = iy*tableNx + ix;
+
+            rowCount += m_countTable[t];
+            rowSumX += m_sumXTable[t];
+            rowSumY += m_sumYTable[t];
+
+            m_countTable[t] = m_countTable[t - tableNx] + rowCount;
+            m_sumXTable[t] = m_sumXTable[t - tableNx] + rowSumX;
+            m_sumYTable[t] = m_sumYTable[t - tableNx] + rowSumY;
+          }
+      }
+
+    /// Duplicate input points as seed points
+    m_seedX.resize(n);
+    m_seedY.resize(n);
+
+    for (long i = 0; i < n; ++i)
+      {
+        m_seedX[i] = static_cast<double>(x[i] - m_xMin);
+        m_seedY[i] = static_cast<double>(y[i] - m_yMin);
+      }
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  void LatticeMeanshiftClusteringFilter<TCoordRep>::_meanshiftIteration()
+  {
+    /// half width of the square window with the area of the disk
+    double halfWidth = m_radius*std::sqrt(vnl_math::pi)/2.0;
+
+    long tableNx = m_nx + 1;
+
+    /// Seeds that have not converged yet, in increasing order
+    std::vector<long> activeSeeds(m_seedX.size());
+    for (std::size_t i = 0; i < activeSeeds.size(); ++i)
+      {
+        activeSeeds[i] = static_cast<long>(i);
+      }
+
+    double convergenceDistance = m_convergenceThreshold*m_radius;
+
+    for (long it = 0; it < m_numberOfMSIteration && !activeSeeds.empty(); ++it)
+      {
+        std::size_t numberOfActiveSeeds = 0;
+
+        for (std::size_t ia = 0; ia < activeSeeds.size(); ++ia)
+          {
+            long i = activeSeeds[ia];
+
+            /// pixels in [x0, x1] x [y0, y1], clamped to the bounding box
+            long x0 = static_cast<long>(std::ceil(m_seedX[i] - halfWidth));
+            long x1 = static_cast<long>(std::floor(m_seedX[i] + halfWidth));
+            long y0 = static_cast<long>(std::ceil(m_seedY[i] - halfWidth));
+            long y1 = static_cast<long>(std::floor(m_seedY[i] + halfWidth));
+
+            x0 = x0>0?x0:0;
+            y0 = y0>0?y0:0;
+            x1 = x1<m_nx-1?x1:m_nx-1;
+            y1 = y1<m_ny-1?y1:m_ny-1;
+
+            long t11 = (y1 + 1)*tableNx + x1 + 1;
+            long t01 = (y1 + 1)*tableNx + x0;
+            long t10 = y0*tableNx + x1 + 1;
+            long t00 = y0*tableNx + x0;
+
+            long count = m_countTable[t11] - m_countTable[t01] - m_countTable[t10] + m_countTable[t00];
+            if (0 == count)
+              {
+                /// can only happen if the window is below one pixel
+                continue;
+              }
+
+            double sumX = m_sumXTable[t11] - m_sumXTable[t01] - m_sumXTable[t10] + m_sumXTable[t00];
+            double sumY = m_sumYTable[t11] - m_sumYTable[t01] - m_sumYTable[t10] + m_sumYTable[t00];
+
+            double newX = sumX/static_cast<double>(count);
+            double newY = sumY/static_cast<double>(count);
+
+            double dx = newX - m_seedX[i];
+            double dy = newY - m_seedY[i];
+
+            m_seedX[i] = newX;
+            m_seedY[i] = newY;
+
+            /// If the increment is small enough, this seed is done and
+            /// is not queried again
+            if (std::sqrt(dx*dx + dy*dy) >= convergenceDistance)
+              {
+                activeSeeds[numberOfActiveSeeds++] = i;
+              }
+          }
+
+        activeSeeds.resize(numberOfActiveSeeds);
+      }
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  void LatticeMeanshiftClusteringFilter<TCoordRep>::_findUniqueCenters()
+  {
+    m_centers = VectorSampleType::New();
+
+    /// the seeds stay in the bounding box
+    m_centerGrid.initialize(0, 0, m_nx - 1, m_ny - 1, m_radius, m_seedX.size());
+
+    for (std::size_t i = 0 ; i < m_seedX.size() ; ++i )
+      {
+        if (m_centerGrid.addIfNoCenterWithinRadius(m_seedX[i], m_seedY[i]))
+          {
+            VectorType center;
+            center[0] = static_cast<TCoordRep>(m_seedX[i] + m_xMin);
+            center[1] = static_cast<TCoordRep>(m_seedY[i] + m_yMin);
+            m_centers->PushBack(center);
+          }
+      }
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  void LatticeMeanshiftClusteringFilter<TCoordRep>::_findLabelOfPoints()
+  {
+    /// label of an input point: the center closest to where its seed
+    /// converged
+    m_labelOfPoints.resize(m_seedX.size());
+
+    for (std::size_t i = 0; i < m_seedX.size(); ++i)
+      {
+        m_labelOfPoints[i] = m_centerGrid.nearestCenter(m_seedX[i], m_seedY[i]);
+      }
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  typename LatticeMeanshiftClusteringFilter<TCoordRep>::VectorSampleType::Pointer
+  LatticeMeanshiftClusteringFilter<TCoordRep>::getCenters()
+  {
+    if (!m_allDone)
+      {
+        std::cerr<<"Error: not done.\n";
+      }
+
+    return m_centers;
+  }
+
+
+  template< typename TCoordRep >
+  std::vector<long>
+  LatticeMeanshiftClusteringFilter<TCoordRep>::getLabelOfPoints()
+  {
+    if (!m_allDone)
+      {
+        std::cerr<<"Error: not done.\n";
+      }
+
+    return m_labelOfPoints;
+  }
+
+}// namespace gth818n
+
+
+#endif
@@ -8,6 +8,12 @@
 #include "itkWeightedCentroidKdTreeGenerator.h"
 #include "itkEuclideanDistanceMetric.h"
 
+// std
+#include <vector>
+
+// local
+#include "PointGrid2D.h"
+
 
 namespace gth818n
 {
@@ -49,11 +55,16 @@ namespace gth818n
     static unsigned int GetPointDimension() { return m_PointDimension; }
 
     void setInputPointSet(typename VectorSampleType::Pointer inputPointSet) {m_inputPointSet = inputPointSet;}
+    /// 2D only: the points (x[i], y[i]), i < n, copied into flat arrays.
+    /// The whole 2D clustering then runs on flat arrays, without ITK
+    /// samples.
+    void setInputPoints(const TCoordRep* x, const TCoordRep* y, long n);
     void setRadius(RealType rad);
     void setEpoch(int epoch);
     void update();
 
     typename VectorSampleType::Pointer getCenters();
+    void getCenters(std::vector<TCoordRep>& x, std::vector<TCoordRep>& y); ///< 2D only
     std::vector<long> getLabelOfPoints();
     /// public fn, end
     //------------------------------------------------------------------------------
@@ -68,6 +79,18 @@ namespace gth818n
     typename TreeGeneratorType::Pointer m_treeGenerator;
     typename TreeType::Pointer m_tree;
 
+    PointGrid2D<TCoordRep> m_grid; ///< neighbor search for NPointDimension == 2, instead of m_tree
+    CenterGrid2D<TCoordRep> m_centerGrid; ///< centers, for NPointDimension == 2
+
+    /// For NPointDimension == 2, the points, seeds and centers are in
+    /// these flat arrays, instead of ListSample's
+    std::vector<TCoordRep> m_inputX;
+    std::vector<TCoordRep> m_inputY;
+    std::vector<TCoordRep> m_seedX;
+    std::vector<TCoordRep> m_seedY;
+    std::vector<TCoordRep> m_centerX;
+    std::vector<TCoordRep> m_centerY;
+
     static const unsigned int m_PointDimension = NPointDimension;
 
     typename VectorSampleType::Pointer m_inputPointSet;
@@ -79,13 +102,18 @@ namespace gth818n
 
     RealType m_radius;
     long m_numberOfMSIteration;
+    RealType m_convergenceThreshold; ///< a seed has converged when it moves less than this times m_radius in one iteration
     long m_numberOfModes;
 
-    int m_epoch; ///< after mean shift on input data, will recursively
-                 ///run mean shift on the obtained data. This give the
-                 ///number of recursion. If 0, just run MS for once:
+    int m_epoch; ///< after mean shift on input data, will run mean
+                 ///shift again on the obtained data. This give the
+                 ///number of extra epochs. If 0, just run MS for once:
                  ///there may be some close but not too close mode
                  ///centers.
+    RealType m_epochRadius; ///< radius of the epochs after the first one
+
+    typename VectorSampleType::Pointer m_epochPointSet; ///< data points of the current epoch, for the KdTree
+    std::vector<long> m_activeSeeds; ///< seeds that have not converged yet, in increasing order
 
     std::vector<long> m_labelOfPoints;
 
@@ -99,10 +127,17 @@ namespace gth818n
     void _computeInputPointRange();
     void _constructKdTree();
     void _meanshiftIteration();
+    void _meanshiftEpoch(RealType radius);
     void _constructSeedPoints();
     void _findUniqueCenters();
     void _findLabelOfPoints();
     typename VectorSampleType::Pointer _getSeedPoints();
+
+    void _update2D();
+    void _meanshiftIteration2D();
+    void _meanshiftEpoch2D(RealType radius);
+    void _findUniqueCenters2D();
+    void _findLabelOfPoints2D();
     /// private fn
     //------------------------------------------------------------------------------
   };
@@ -14,19 +14,48 @@ namespace gth818n
   MeanshiftClusteringFilter<TCoordRep, NPointDimension>::MeanshiftClusteringFilter()
   {
     m_epoch = 2;
+    m_epochRadius = 3.0;
     m_inputPointSet = 0;
     m_seedPoints = 0;
 
     m_numberOfMSIteration = 100;
+    m_convergenceThreshold = 1e-3;
 
     m_radius = 3.0;
     m_allDone = false;
   }
 
 
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::setInputPoints(const TCoordRep* x, const TCoordRep* y, long n)
+  {
+    if (2 != NPointDimension)
+      {
+        std::cerr<<"Error: setInputPoints is for 2D points only.\n";
+        abort();
+      }
+
+    m_inputPointSet = 0;
+
+    m_inputX.assign(x, x + n);
+    m_inputY.assign(y, y + n);
+
+    return;
+  }
+
+
   template< typename TCoordRep, unsigned int NPointDimension >
   void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::update()
   {
+    if (2 == NPointDimension)
+      {
+        _update2D();
+
+        m_allDone = true;
+
+        return;
+      }
+
     // //dbg
     // std::cout<<"_constructKdTree..."<<std::flush;
     // //dbg, end
@@ -51,6 +80,49 @@ namespace gth818n
     return;
   }
 
+
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_update2D()
+  {
+    if (m_inputPointSet)
+      {
+        /// ListSample input: copy it to the flat arrays once
+        long n = m_inputPointSet->Size();
+
+        m_inputX.resize(n);
+        m_inputY.resize(n);
+
+        for (long itp = 0; itp < n; ++itp)
+          {
+            const VectorType& thisPoint = m_inputPointSet->GetMeasurementVector(itp);
+            m_inputX[itp] = thisPoint[0];
+            m_inputY[itp] = thisPoint[1];
+          }
+      }
+
+    if (m_inputX.empty())
+      {
+        std::cerr<<"Error: means shift input point set is empty.\n";
+        abort();
+      }
+
+    /// cell size = radius: a radius search scans 3x3 cells
+    m_grid.build(&m_inputX[0], &m_inputY[0], m_inputX.size(), m_radius);
+
+    /// Duplicate input points as seed points
+    m_seedX = m_inputX;
+    m_seedY = m_inputY;
+
+    _meanshiftIteration2D();
+
+    _findUniqueCenters2D();
+
+    _findLabelOfPoints2D();
+
+    return;
+  }
+
+
   template< typename TCoordRep, unsigned int NPointDimension >
   void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::setRadius(RealType rad)
   {
@@ -147,16 +219,60 @@ namespace gth818n
 
   template< typename TCoordRep, unsigned int NPointDimension >
   void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_meanshiftIteration()
+  {
+    _meanshiftEpoch(m_radius);
+
+    /// Each further epoch runs mean shift on the seeds where the
+    /// previous one converged. The tree generator and the point set
+    /// holding those seeds are reused.
+    for (int iepoch = 0; iepoch < m_epoch; ++iepoch)
+      {
+        if (!m_epochPointSet)
+          {
+            m_epochPointSet = VectorSampleType::New();
+          }
+
+        m_epochPointSet->Resize(m_seedPoints->Size());
+
+        for (unsigned int itp = 0; itp < m_seedPoints->Size(); ++itp)
+          {
+            m_epochPointSet->SetMeasurementVector(itp, m_seedPoints->GetMeasurementVector(itp));
+          }
+
+        m_treeGenerator->SetSample( m_epochPointSet );
+        m_treeGenerator->Update();
+        m_tree = m_treeGenerator->GetOutput();
+
+        _meanshiftEpoch(m_epochRadius);
+      }
+
+    return;
+  }
+
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_meanshiftEpoch(RealType radius)
   {
     VectorType queryPoint;
     typename TreeType::InstanceIdentifierVectorType neighbors;
 
-    for (long it = 0; it < m_numberOfMSIteration; ++it)
+    m_activeSeeds.resize(m_seedPoints->Size());
+    for (unsigned int itp = 0; itp < m_seedPoints->Size(); ++itp)
       {
-        for (unsigned int itp = 0; itp < m_seedPoints->Size(); ++itp)
+        m_activeSeeds[itp] = itp;
+      }
+
+    RealType convergenceDistance = m_convergenceThreshold*radius;
+
+    for (long it = 0; it < m_numberOfMSIteration && !m_activeSeeds.empty(); ++it)
+      {
+        std::size_t numberOfActiveSeeds = 0;
+
+        for (std::size_t ia = 0; ia < m_activeSeeds.size(); ++ia)
           {
+            long itp = m_activeSeeds[ia];
             queryPoint = m_seedPoints->GetMeasurementVector(itp);
-            m_tree->Search( queryPoint, m_radius, neighbors ) ;
+
+            m_tree->Search( queryPoint, radius, neighbors ) ;
 
             VectorType newPosition;
             newPosition.Fill(0);
@@ -171,27 +287,80 @@ namespace gth818n
 
             m_seedPoints->SetMeasurementVector(itp, newPosition);
 
-            /// If relative incremental is small enough, break
+            /// If the increment is small enough, this seed is done and
+            /// is not queried again
             VectorType del = queryPoint - newPosition;
-            for (unsigned int idim = 0; idim < NPointDimension; ++idim)
+            if (del.GetNorm() >= convergenceDistance)
               {
-                del[idim] /= m_inputPointSetRange[idim];
+                m_activeSeeds[numberOfActiveSeeds++] = itp;
               }
+          }
+
+        m_activeSeeds.resize(numberOfActiveSeeds);
+      }
+
+    return;
+  }
+
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_meanshiftIteration2D()
+  {
+    _meanshiftEpoch2D(m_radius);
 
-            if (del.GetNorm() < 1e-1)
+    /// Each further epoch runs mean shift on the seeds where the
+    /// previous one converged. m_grid keeps its own copy of the points,
+    /// so it is rebuilt in place from the seeds.
+    for (int iepoch = 0; iepoch < m_epoch; ++iepoch)
+      {
+        m_grid.build(&m_seedX[0], &m_seedY[0], m_seedX.size(), m_epochRadius);
+
+        _meanshiftEpoch2D(m_epochRadius);
+      }
+
+    return;
+  }
+
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_meanshiftEpoch2D(RealType radius)
+  {
+    long n = m_seedX.size();
+
+    m_activeSeeds.resize(n);
+    for (long itp = 0; itp < n; ++itp)
+      {
+        m_activeSeeds[itp] = itp;
+      }
+
+    double convergenceDistance2 = m_convergenceThreshold*radius*m_convergenceThreshold*radius;
+
+    for (long it = 0; it < m_numberOfMSIteration && !m_activeSeeds.empty(); ++it)
+      {
+        std::size_t numberOfActiveSeeds = 0;
+
+        for (std::size_t ia = 0; ia < m_activeSeeds.size(); ++ia)
+          {
+            long itp = m_activeSeeds[ia];
+
+            TCoordRep oldX = m_seedX[itp];
+            TCoordRep oldY = m_seedY[itp];
+
+            double sumX, sumY;
+            long numberOfNeighbors = m_grid.sumInRadius(oldX, oldY, radius, sumX, sumY);
+
+            m_seedX[itp] = static_cast<TCoordRep>(sumX/static_cast<double>(numberOfNeighbors));
+            m_seedY[itp] = static_cast<TCoordRep>(sumY/static_cast<double>(numberOfNeighbors));
+
+            /// If the increment is small enough, this seed is done and
+            /// is not queried again
+            double dx = static_cast<double>(oldX - m_seedX[itp]);
+            double dy = static_cast<double>(oldY - m_seedY[itp]);
+            if (dx*dx + dy*dy >= convergenceDistance2)
               {
-                break;
+                m_activeSeeds[numberOfActiveSeeds++] = itp;
               }
           }
-      }
 
-    if (m_epoch)
-      {
-        MeanshiftClusteringFilter<TCoordRep, NPointDimension> ms;
-        ms.setInputPointSet(m_seedPoints);
-        ms.setEpoch(--m_epoch);
-        ms.update();
-        m_seedPoints = ms._getSeedPoints();
+        m_activeSeeds.resize(numberOfActiveSeeds);
       }
 
     return;
@@ -218,14 +387,48 @@ namespace gth818n
         std::cerr<<"Error: not done.\n";
       }
 
+    if (2 == NPointDimension && !m_centers)
+      {
+        m_centers = VectorSampleType::New();
+
+        VectorType center;
+        for (std::size_t ic = 0; ic < m_centerX.size(); ++ic)
+          {
+            center[0] = m_centerX[ic];
+            center[1] = m_centerY[ic];
+            m_centers->PushBack(center);
+          }
+      }
+
     return m_centers;
   }
 
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::getCenters(std::vector<TCoordRep>& x, std::vector<TCoordRep>& y)
+  {
+    if (!m_allDone)
+      {
+        std::cerr<<"Error: not done.\n";
+      }
+
+    if (2 != NPointDimension)
+      {
+        std::cerr<<"Error: getCenters(x, y) is for 2D points only.\n";
+        abort();
+      }
+
+    x = m_centerX;
+    y = m_centerY;
+
+    return;
+  }
+
   template< typename TCoordRep, unsigned int NPointDimension >
   void
   MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_findUniqueCenters()
   {
     m_centers = VectorSampleType::New();
+
     m_centers->PushBack( m_seedPoints->GetMeasurementVector(0) );
 
     for (unsigned int i = 1 ; i < m_seedPoints->Size() ; ++i )
@@ -254,6 +457,47 @@ namespace gth818n
     return;
   }
 
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void
+  MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_findUniqueCenters2D()
+  {
+    /// Same greedy rule as _findUniqueCenters, looking only at the
+    /// centers in the neighboring cells
+    long n = m_seedX.size();
+
+    TCoordRep xMin = m_seedX[0];
+    TCoordRep xMax = m_seedX[0];
+    TCoordRep yMin = m_seedY[0];
+    TCoordRep yMax = m_seedY[0];
+
+    for (long i = 1; i < n; ++i)
+      {
+        xMin = xMin<m_seedX[i]?xMin:m_seedX[i];
+        xMax = xMax>m_seedX[i]?xMax:m_seedX[i];
+        yMin = yMin<m_seedY[i]?yMin:m_seedY[i];
+        yMax = yMax>m_seedY[i]?yMax:m_seedY[i];
+      }
+
+    m_centerGrid.initialize(xMin, yMin, xMax, yMax, m_radius, n);
+
+    m_centers = 0;
+    m_centerX.clear();
+    m_centerY.clear();
+
+    for (long i = 0; i < n; ++i)
+      {
+        if (m_centerGrid.addIfNoCenterWithinRadius(m_seedX[i], m_seedY[i]))
+          {
+            m_centerX.push_back(m_seedX[i]);
+            m_centerY.push_back(m_seedY[i]);
+          }
+      }
+
+    m_numberOfModes = m_centerX.size();
+
+    return;
+  }
+
   template< typename TCoordRep, unsigned int NPointDimension >
   std::vector<long>
   MeanshiftClusteringFilter<TCoordRep, NPointDimension>::getLabelOfPoints()
@@ -294,6 +538,23 @@ namespace gth818n
   }
 
 
+  template< typename TCoordRep, unsigned int NPointDimension >
+  void
+  MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_findLabelOfPoints2D()
+  {
+    /// Each seed is within m_radius of a center, so its closest center
+    /// is in the neighboring cells of m_centerGrid
+    m_labelOfPoints.resize(m_seedX.size());
+
+    for (std::size_t i = 0 ; i < m_seedX.size() ; ++i )
+      {
+        m_labelOfPoints[i] = m_centerGrid.nearestCenter(m_seedX[i], m_seedY[i]);
+      }
+
+    return;
+  }
+
+
   template< typename TCoordRep, unsigned int NPointDimension >
   void MeanshiftClusteringFilter<TCoordRep, NPointDimension>::_constructSeedPoints()
   {
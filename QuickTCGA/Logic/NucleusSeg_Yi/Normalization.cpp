@@ -7,6 +7,11 @@
 
 #include "Normalization.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <vector>
+
 namespace nscale {
 /*% Segment foreground from background using discriminant functions
     %inputs:
@@ -494,6 +499,315 @@ cv::Mat Normalization::normalization(const cv::Mat& originalI, float targetMean[
     return ColorNormI;
 }
 
+// Fused normalization ---------------------------------------------------------
+// normalization() runs segFG, bgr2Lab, TransferI and lab2BGR as separate passes
+// over float images. Per pixel it only depends on the BGR value, the foreground
+// flag and the foreground lab statistics, so it is done here in two passes over
+// the uint8 image: the statistics, then the output.
+
+// Pixels per block: the block temporaries stay in cache, and the loops over a
+// block are branch free so that the compiler vectorizes them.
+static const int FusedBlockSize = 256;
+
+// log10(x) for a normal x > 0, relative error about 1e-7
+static inline float fusedLog10(float x)
+{
+    // x = 2^e m with m in [sqrt(1/2), sqrt(2))
+    int bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    int e = (bits - 0x3f3504f3) >> 23;
+    bits -= e << 23;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    // ln(m) = 2 atanh(t), |t| < 0.172
+    float t = (m - 1.0f) / (m + 1.0f);
+    float t2 = t * t;
+    float lnm = 2.0f * t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f))));
+
+    return (static_cast<float>(e) * 0.693147181f + lnm) * 0.434294482f;
+}
+
+// 10^y, 0 where it is out of the normal float range (lab2BGR zeroes inf)
+static inline float fusedExp10(float y)
+{
+    float z = y * 3.32192809f; // log2(10)
+    float inRange = (z > -126.0f ? 1.0f : 0.0f) * (z < 127.0f ? 1.0f : 0.0f);
+    z *= inRange;
+
+    // n = round(z), 2^(z - n) = e^u with |u| <= ln(2)/2
+    int n = static_cast<int>(z + 126.5f) - 126;
+    float u = (z - static_cast<float>(n)) * 0.693147181f;
+    float p = 1.0f + u * (1.0f + u * (0.5f + u * (1.0f / 6.0f + u * (1.0f / 24.0f + u * (1.0f / 120.0f + u * (1.0f / 720.0f))))));
+
+    int bits = (n + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+
+    return p * scale * inRange;
+}
+
+// Constants of the steps of normalization(), in the order they are applied
+struct FusedNormalizationTransform {
+    float discriminant[8]; // M of segFG
+    float toLMS[9]; // bgr2Lab Matrix1 / 255, columns in B, G, R order
+    float toLab[9]; // bgr2Lab Matrix2
+    float meanLAB[3]; // TransferI, foreground only
+    float scaleLAB[3];
+    float meanT[3];
+    float foregroundValid; // 0 if the statistics are not finite: the foreground is black, as the NaNs of TransferI
+    float toLogLMS[9]; // lab2BGR Matrix1
+    float toBGR[9]; // lab2BGR Matrix2, rows in B, G, R order
+};
+
+static void initFusedNormalizationTransform(FusedNormalizationTransform& t)
+{
+    float mData[8] = { -0.154f, 0.035f, 0.549f, -45.718f, -0.057f, -0.817f, 1.170f, -49.887f };
+    for (int i = 0; i < 8; i++) {
+        t.discriminant[i] = mData[i];
+    }
+
+    double matrix1[9] = { 0.3811, 0.5783, 0.0402, 0.1967, 0.7244, 0.0782, 0.0241, 0.1288, 0.8444 };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            t.toLMS[i * 3 + j] = static_cast<float>(matrix1[i * 3 + 2 - j] / 255.0);
+        }
+    }
+
+    float diagLab[3] = { 1 / sqrtf(3.0), 1 / sqrtf(6.0), 1 / sqrtf(2.0) };
+    float auxLab[9] = { 1, 1, 1, 1, 1, -2, 1, -1, 0 };
+    float auxLMS[9] = { 1, 1, 1, 1, 1, -1, 1, -2, 0 };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            t.toLab[i * 3 + j] = diagLab[i] * auxLab[i * 3 + j];
+            t.toLogLMS[i * 3 + j] = auxLMS[i * 3 + j] * diagLab[j];
+        }
+    }
+
+    float matrix2[9] = { 4.4687f, -3.5887f, 0.1196f, -1.2197f, 2.3831f, -0.1626f, 0.0585f, -0.2611f, 1.2057f };
+    for (int j = 0; j < 3; j++) {
+        t.toBGR[j] = matrix2[6 + j];
+        t.toBGR[3 + j] = matrix2[3 + j];
+        t.toBGR[6 + j] = matrix2[j];
+    }
+
+    for (int i = 0; i < 3; i++) {
+        t.meanLAB[i] = 0.0f;
+        t.scaleLAB[i] = 1.0f;
+        t.meanT[i] = 0.0f;
+    }
+    t.foregroundValid = 1.0f;
+}
+
+// Foreground flag, validity (not black, whose log LMS is -inf) and lab of n
+// BGR pixels. The flags are 0 or 1.
+static void fusedLab(const unsigned char* bgr, int n, const FusedNormalizationTransform& t,
+                     float* fg, float* valid, float* L, float* A, float* B)
+{
+    // in locals: loaded once, not after each store to L, A, B
+    float M[8], P[9], T[9];
+    std::memcpy(M, t.discriminant, sizeof(M));
+    std::memcpy(P, t.toLMS, sizeof(P));
+    std::memcpy(T, t.toLab, sizeof(T));
+
+    // R, G, B in place of L, A, B. A loop of its own, or the one below is not vectorized
+    for (int j = 0; j < n; j++) {
+        L[j] = static_cast<float>(bgr[j * 3 + 2]);
+        A[j] = static_cast<float>(bgr[j * 3 + 1]);
+        B[j] = static_cast<float>(bgr[j * 3]);
+    }
+
+    for (int j = 0; j < n; j++) {
+        float r = L[j];
+        float g = A[j];
+        float b = B[j];
+
+        float discriminant1 = M[0] * r + M[1] * g + M[2] * b + M[3];
+        float discriminant2 = M[4] * r + M[5] * g + M[6] * b + M[7];
+        fg[j] = discriminant1 < discriminant2 ? 1.0f : 0.0f;
+
+        // all the coefficients are > 0: the three are 0 together, for black only
+        float l = P[0] * b + P[1] * g + P[2] * r;
+        float m = P[3] * b + P[4] * g + P[5] * r;
+        float s = P[6] * b + P[7] * g + P[8] * r;
+        valid[j] = l > 0.0f ? 1.0f : 0.0f;
+
+        // + FLT_MIN: finite for black, unchanged otherwise
+        float logL = fusedLog10(l + FLT_MIN);
+        float logM = fusedLog10(m + FLT_MIN);
+        float logS = fusedLog10(s + FLT_MIN);
+
+        L[j] = logL * T[0] + logM * T[1] + logS * T[2];
+        A[j] = logL * T[3] + logM * T[4] + logS * T[5];
+        B[j] = logL * T[6] + logM * T[7] + logS * T[8];
+    }
+}
+
+// Sums of lab and lab^2 over the pixels TransferI takes its statistics from,
+// per row, so that the sum over the rows does not depend on the threading
+class FusedStatisticsBody : public cv::ParallelLoopBody {
+public:
+    FusedStatisticsBody(const cv::Mat& image, const FusedNormalizationTransform& transform, std::vector<double>& rowSums)
+            : m_image(image), m_transform(transform), m_rowSums(rowSums) {}
+
+    virtual void operator()(const cv::Range& range) const {
+        float fg[FusedBlockSize], valid[FusedBlockSize], L[FusedBlockSize], A[FusedBlockSize], B[FusedBlockSize];
+
+        for (int i = range.start; i < range.end; i++) {
+            const unsigned char* row = m_image.ptr<unsigned char>(i);
+            double* sums = &m_rowSums[i * 7];
+
+            for (int j0 = 0; j0 < m_image.cols; j0 += FusedBlockSize) {
+                int n = std::min(FusedBlockSize, m_image.cols - j0);
+                fusedLab(row + j0 * 3, n, m_transform, fg, valid, L, A, B);
+
+                float count = 0, sumL = 0, sumA = 0, sumB = 0, sqL = 0, sqA = 0, sqB = 0;
+                for (int j = 0; j < n; j++) {
+                    // mask1 of TransferI: foreground, finite and L*a*b > 0
+                    float w = (L[j] * A[j] * B[j] > 0.0f ? 1.0f : 0.0f) * fg[j] * valid[j];
+                    count += w;
+                    sumL += w * L[j];
+                    sumA += w * A[j];
+                    sumB += w * B[j];
+                    sqL += w * L[j] * L[j];
+                    sqA += w * A[j] * A[j];
+                    sqB += w * B[j] * B[j];
+                }
+
+                sums[0] += count;
+                sums[1] += sumL;
+                sums[2] += sumA;
+                sums[3] += sumB;
+                sums[4] += sqL;
+                sums[5] += sqA;
+                sums[6] += sqB;
+            }
+        }
+    }
+
+private:
+    const cv::Mat& m_image;
+    const FusedNormalizationTransform& m_transform;
+    std::vector<double>& m_rowSums;
+};
+
+// Transfer of the foreground lab, and back to BGR
+class FusedTransformBody : public cv::ParallelLoopBody {
+public:
+    FusedTransformBody(const cv::Mat& image, const FusedNormalizationTransform& transform, cv::Mat& output)
+            : m_image(image), m_transform(transform), m_output(output) {}
+
+    virtual void operator()(const cv::Range& range) const {
+        float fg[FusedBlockSize], valid[FusedBlockSize], L[FusedBlockSize], A[FusedBlockSize], B[FusedBlockSize];
+        const FusedNormalizationTransform& t = m_transform;
+        const float* T = t.toLogLMS;
+        const float* C = t.toBGR;
+
+        for (int i = range.start; i < range.end; i++) {
+            const unsigned char* row = m_image.ptr<unsigned char>(i);
+            unsigned char* outputRow = m_output.ptr<unsigned char>(i);
+
+            for (int j0 = 0; j0 < m_image.cols; j0 += FusedBlockSize) {
+                int n = std::min(FusedBlockSize, m_image.cols - j0);
+                fusedLab(row + j0 * 3, n, t, fg, valid, L, A, B);
+
+                // B, G, R in place of L, A, B
+                for (int j = 0; j < n; j++) {
+                    // the background keeps its lab: mean 0, scale 1
+                    float f = fg[j];
+                    float l = (L[j] - f * t.meanLAB[0]) * (1.0f + f * (t.scaleLAB[0] - 1.0f)) + f * t.meanT[0];
+                    float a = (A[j] - f * t.meanLAB[1]) * (1.0f + f * (t.scaleLAB[1] - 1.0f)) + f * t.meanT[1];
+                    float b = (B[j] - f * t.meanLAB[2]) * (1.0f + f * (t.scaleLAB[2] - 1.0f)) + f * t.meanT[2];
+
+                    float lms0 = fusedExp10(l * T[0] + a * T[1] + b * T[2]);
+                    float lms1 = fusedExp10(l * T[3] + a * T[4] + b * T[5]);
+                    float lms2 = fusedExp10(l * T[6] + a * T[7] + b * T[8]);
+
+                    // *255 and clamp
+                    float scale = 255.0f * valid[j] * (1.0f - f * (1.0f - t.foregroundValid));
+                    L[j] = std::min(std::max((lms0 * C[0] + lms1 * C[1] + lms2 * C[2]) * scale, 0.0f), 255.0f);
+                    A[j] = std::min(std::max((lms0 * C[3] + lms1 * C[4] + lms2 * C[5]) * scale, 0.0f), 255.0f);
+                    B[j] = std::min(std::max((lms0 * C[6] + lms1 * C[7] + lms2 * C[8]) * scale, 0.0f), 255.0f);
+                }
+
+                // round half up as rndint
+                unsigned char* out = outputRow + j0 * 3;
+                for (int j = 0; j < n; j++) {
+                    out[j * 3] = static_cast<unsigned char>(static_cast<int>(L[j] + 0.5f));
+                    out[j * 3 + 1] = static_cast<unsigned char>(static_cast<int>(A[j] + 0.5f));
+                    out[j * 3 + 2] = static_cast<unsigned char>(static_cast<int>(B[j] + 0.5f));
+                }
+            }
+        }
+    }
+
+private:
+    const cv::Mat& m_image;
+    const FusedNormalizationTransform& m_transform;
+    cv::Mat& m_output;
+};
+
+cv::Mat Normalization::fusedNormalization(const cv::Mat& originalI, float targetMean[3], float targetStd[3], int numberOfThreads)
+{
+    CV_Assert(originalI.type() == CV_8UC3);
+
+    FusedNormalizationTransform transform;
+    initFusedNormalizationTransform(transform);
+
+    cv::Range rows(0, originalI.rows);
+
+    // statistics pass
+    std::vector<double> rowSums(originalI.rows * 7, 0.0);
+    FusedStatisticsBody statistics(originalI, transform, rowSums);
+    if (1 == numberOfThreads) {
+        statistics(rows);
+    } else {
+        cv::parallel_for_(rows, statistics);
+    }
+
+    double sums[7] = { 0, 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < originalI.rows; i++) {
+        for (int k = 0; k < 7; k++) {
+            sums[k] += rowSums[i * 7 + k];
+        }
+    }
+
+    // as TransferI
+    for (int n = 0; n < 3; n++) {
+        double mean = sums[1 + n] / sums[0];
+        double variance = sums[4 + n] / sums[0] - mean * mean;
+        float stdLAB = static_cast<float>(sqrt(variance));
+
+        transform.meanLAB[n] = static_cast<float>(mean);
+        transform.scaleLAB[n] = targetStd[n] / stdLAB;
+        transform.meanT[n] = targetMean[n];
+
+        // no foreground, or a flat one
+        if (!(fabsf(transform.meanLAB[n]) <= FLT_MAX && fabsf(transform.scaleLAB[n]) <= FLT_MAX)) {
+            transform.foregroundValid = 0.0f;
+        }
+    }
+
+    if (0.0f == transform.foregroundValid) {
+        for (int n = 0; n < 3; n++) {
+            transform.meanLAB[n] = 0.0f;
+            transform.scaleLAB[n] = 1.0f;
+            transform.meanT[n] = 0.0f;
+        }
+    }
+
+    // transform pass
+    cv::Mat ColorNormI(originalI.size(), CV_8UC3);
+    FusedTransformBody transferred(originalI, transform, ColorNormI);
+    if (1 == numberOfThreads) {
+        transferred(rows);
+    } else {
+        cv::parallel_for_(rows, transferred);
+    }
+
+    return ColorNormI;
+}
+
 /*function [Mean Std] = TargetParameters(TargetI, M)
     % Calculates mapping parameters for use in color normalization.
     %inputs:
@@ -47,6 +47,10 @@ public:
     // normalization operations that mimics our matlab code. It uses as an input the BGR image and
     // mean/std of the lab channels computed from the target image using the function targetParameters bellow.
     static cv::Mat normalization(const cv::Mat& originalI, float targetMean[3], float targetStd[3]);
+    // Same result as normalization, within 1 gray level, without the float images: one pass over
+    // the BGR image for the foreground lab statistics and one for the output, with polynomial
+    // log10/exp10. numberOfThreads 1: serial, otherwise rows in parallel.
+    static cv::Mat fusedNormalization(const cv::Mat& originalI, float targetMean[3], float targetStd[3], int numberOfThreads = 1);
     static void targetParameters(const cv::Mat& originalI, float(&targetMean)[3], float(&targetStd)[3]);
     // segFG() must be public; being called from utilityTileAnalysis.h
     static cv::Mat segFG(cv::Mat I, cv::Mat M);
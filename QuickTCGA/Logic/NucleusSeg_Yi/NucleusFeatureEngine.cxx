@@ -0,0 +1,474 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+// openCV
+#include "opencv2/core/core.hpp"
+
+// local
+#include "NucleusFeatureEngine.h"
+#include "LabelShapeAttributes2D.h"
+
+
+namespace gth818n
+{
+  typedef std::pair<float, float> NucleusHullPointType;
+
+  /// Sums over the pixels of each label of one tile, indexed by the
+  /// rank of the label among the labels of the tile
+  struct NucleusAccumulators
+  {
+    std::vector<long> numberOfPixels;
+    std::vector<double> sumX;
+    std::vector<double> sumY;
+    std::vector<double> sumXX;
+    std::vector<double> sumYY;
+    std::vector<double> sumXY;
+    std::vector<double> sumH;
+    std::vector<double> sumHH;
+    std::vector<double> sumE;
+    std::vector<double> sumEE;
+    std::vector<long> axesIntercepts;
+    std::vector<long> diagonalIntercepts;
+    std::vector< std::vector<NucleusHullPointType> > hullPoints; ///< corners of the first and last pixel of each run
+
+    void grow(std::size_t n)
+    {
+      numberOfPixels.resize(n, 0);
+      sumX.resize(n, 0.0);
+      sumY.resize(n, 0.0);
+      sumXX.resize(n, 0.0);
+      sumYY.resize(n, 0.0);
+      sumXY.resize(n, 0.0);
+      sumH.resize(n, 0.0);
+      sumHH.resize(n, 0.0);
+      sumE.resize(n, 0.0);
+      sumEE.resize(n, 0.0);
+      axesIntercepts.resize(n, 0);
+      diagonalIntercepts.resize(n, 0);
+      hullPoints.resize(n);
+    }
+  };
+
+
+  /// Cross product of (a - o) and (b - o)
+  static double nucleusHullCross(const NucleusHullPointType& o, const NucleusHullPointType& a, const NucleusHullPointType& b)
+  {
+    return (static_cast<double>(a.first) - o.first)*(static_cast<double>(b.second) - o.second)
+      - (static_cast<double>(a.second) - o.second)*(static_cast<double>(b.first) - o.first);
+  }
+
+
+  /// Area of the convex hull of the points (monotone chain). Sorts the
+  /// points.
+  static double convexHullArea(std::vector<NucleusHullPointType>& points)
+  {
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    long n = points.size();
+    if (n < 3)
+      {
+        return 0.0;
+      }
+
+    std::vector<NucleusHullPointType> hull(2*n);
+    long k = 0;
+
+    for (long i = 0; i < n; ++i)
+      {
+        while (k >= 2 && nucleusHullCross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+          {
+            --k;
+          }
+        hull[k++] = points[i];
+      }
+
+    for (long i = n - 2, lower = k + 1; i >= 0; --i)
+      {
+        while (k >= lower && nucleusHullCross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+          {
+            --k;
+          }
+        hull[k++] = points[i];
+      }
+
+    /// the last point is the first one again
+    double area = 0.0;
+    for (long i = 0; i < k - 1; ++i)
+      {
+        area += static_cast<double>(hull[i].first)*hull[i + 1].second - static_cast<double>(hull[i + 1].first)*hull[i].second;
+      }
+
+    return std::fabs(area)/2.0;
+  }
+
+
+  /// All features of the nuclei of one tile, in one scan of the tile
+  static void computeTileFeatures(const NucleusFeatureEngine::Tile& tile, int tileIndex, float mpp, NucleusFeatureTable& table)
+  {
+    typedef NucleusFeatureEngine::LabelType LabelType;
+
+    /// The labels of the tile, sorted: the accumulators grow with the
+    /// number of objects, not with the largest label. One entry per run
+    /// is enough to see them all.
+    std::vector<LabelType> labels;
+    for (long iy = 0; iy < tile.ny; ++iy)
+      {
+        const LabelType* row = tile.labels + iy*tile.nx;
+        for (long ix = 0; ix < tile.nx; ++ix)
+          {
+            if (0 != row[ix] && (0 == ix || row[ix - 1] != row[ix]))
+              {
+                labels.push_back(row[ix]);
+              }
+          }
+      }
+
+    std::sort(labels.begin(), labels.end());
+    labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+
+    NucleusAccumulators acc;
+    acc.grow(labels.size());
+
+    for (long iy = 0; iy < tile.ny; ++iy)
+      {
+        const LabelType* row = tile.labels + iy*tile.nx;
+        const LabelType* rowAbove = iy > 0 ? row - tile.nx : 0;
+        const LabelType* rowBelow = iy < tile.ny - 1 ? row + tile.nx : 0;
+
+        std::size_t l = 0;
+        for (long ix = 0; ix < tile.nx; ++ix)
+          {
+            if (0 == row[ix])
+              {
+                continue;
+              }
+
+            /// the rank of the label, searched once per run
+            if (0 == ix || row[ix - 1] != row[ix])
+              {
+                l = std::lower_bound(labels.begin(), labels.end(), row[ix]) - labels.begin();
+              }
+
+            ++acc.numberOfPixels[l];
+
+            double x = static_cast<double>(ix);
+            double y = static_cast<double>(iy);
+
+            acc.sumX[l] += x;
+            acc.sumY[l] += y;
+            acc.sumXX[l] += x*x;
+            acc.sumYY[l] += y*y;
+            acc.sumXY[l] += x*y;
+
+            long offset = iy*tile.nx + ix;
+
+            double h = tile.hematoxylin[offset];
+            acc.sumH[l] += h;
+            acc.sumHH[l] += h*h;
+
+            if (tile.eosin)
+              {
+                double e = tile.eosin[offset];
+                acc.sumE[l] += e;
+                acc.sumEE[l] += e*e;
+              }
+
+            LabelShapeAttributes2D<LabelType>::countIntercepts(row, rowAbove, rowBelow, ix, tile.nx,
+                                                               acc.axesIntercepts[l], acc.diagonalIntercepts[l]);
+
+            /// The hull of the pixels is the hull of the outer corners
+            /// of the ends of the runs
+            float fx = static_cast<float>(ix);
+            float fy = static_cast<float>(iy);
+
+            if (0 == ix || row[ix - 1] != row[ix])
+              {
+                acc.hullPoints[l].push_back(NucleusHullPointType(fx - 0.5f, fy - 0.5f));
+                acc.hullPoints[l].push_back(NucleusHullPointType(fx - 0.5f, fy + 0.5f));
+              }
+
+            if (tile.nx - 1 == ix || row[ix + 1] != row[ix])
+              {
+                acc.hullPoints[l].push_back(NucleusHullPointType(fx + 0.5f, fy - 0.5f));
+                acc.hullPoints[l].push_back(NucleusHullPointType(fx + 0.5f, fy + 0.5f));
+              }
+          }
+      }
+
+    for (std::size_t l = 0; l < labels.size(); ++l)
+      {
+        double n = static_cast<double>(acc.numberOfPixels[l]);
+
+        double cx = acc.sumX[l]/n;
+        double cy = acc.sumY[l]/n;
+
+        /// Second central moments, with 1/12 for the extent of a pixel,
+        /// as regionprops
+        double uxx = acc.sumXX[l]/n - cx*cx + 1.0/12.0;
+        double uyy = acc.sumYY[l]/n - cy*cy + 1.0/12.0;
+        double uxy = acc.sumXY[l]/n - cx*cy;
+        double common = std::sqrt((uxx - uyy)*(uxx - uyy) + 4.0*uxy*uxy);
+
+        double majorAxis = 2.0*std::sqrt(2.0)*std::sqrt(uxx + uyy + common);
+        double minorAxis = 2.0*std::sqrt(2.0)*std::sqrt(std::max(0.0, uxx + uyy - common));
+        double eccentricity = majorAxis > 0 ? std::sqrt(std::max(0.0, 1.0 - minorAxis*minorAxis/(majorAxis*majorAxis))) : 0.0;
+
+        double hullArea = convexHullArea(acc.hullPoints[l]);
+
+        double meanH = acc.sumH[l]/n;
+        double meanE = acc.sumE[l]/n;
+
+        table.tileIndex.push_back(tileIndex);
+        table.label.push_back(static_cast<unsigned int>(labels[l]));
+        table.centroidX.push_back(static_cast<float>(tile.originX + cx));
+        table.centroidY.push_back(static_cast<float>(tile.originY + cy));
+        table.area.push_back(static_cast<float>(mpp*mpp*n));
+        table.perimeter.push_back(static_cast<float>(LabelShapeAttributes2D<LabelType>::croftonPerimeter(acc.axesIntercepts[l], acc.diagonalIntercepts[l], mpp)));
+        table.majorAxisLength.push_back(static_cast<float>(mpp*majorAxis));
+        table.minorAxisLength.push_back(static_cast<float>(mpp*minorAxis));
+        table.eccentricity.push_back(static_cast<float>(eccentricity));
+        table.solidity.push_back(static_cast<float>(hullArea > 0 ? n/hullArea : 1.0));
+        table.hematoxylinMean.push_back(static_cast<float>(meanH));
+        table.hematoxylinStd.push_back(static_cast<float>(std::sqrt(std::max(0.0, acc.sumHH[l]/n - meanH*meanH))));
+        table.eosinMean.push_back(static_cast<float>(meanE));
+        table.eosinStd.push_back(static_cast<float>(std::sqrt(std::max(0.0, acc.sumEE[l]/n - meanE*meanE))));
+      }
+
+    return;
+  }
+
+
+  /// Features of the tiles, each tile to its own table
+  class NucleusFeatureBody : public cv::ParallelLoopBody
+  {
+  public:
+    NucleusFeatureBody(const std::vector<NucleusFeatureEngine::Tile>& tiles, std::vector<NucleusFeatureTable>& tables, float mpp)
+      : m_tiles(tiles), m_tables(tables), m_mpp(mpp) {}
+
+    virtual void operator()(const cv::Range& range) const
+    {
+      for (int it = range.start; it < range.end; ++it)
+        {
+          computeTileFeatures(m_tiles[it], it, m_mpp, m_tables[it]);
+        }
+    }
+
+  private:
+    const std::vector<NucleusFeatureEngine::Tile>& m_tiles;
+    std::vector<NucleusFeatureTable>& m_tables;
+    float m_mpp;
+  };
+
+
+  void NucleusFeatureTable::clear()
+  {
+    *this = NucleusFeatureTable();
+
+    return;
+  }
+
+
+  template< typename T >
+  static void appendColumn(std::vector<T>& column, const std::vector<T>& other)
+  {
+    column.insert(column.end(), other.begin(), other.end());
+  }
+
+
+  void NucleusFeatureTable::append(const NucleusFeatureTable& other)
+  {
+    appendColumn(tileIndex, other.tileIndex);
+    appendColumn(label, other.label);
+    appendColumn(centroidX, other.centroidX);
+    appendColumn(centroidY, other.centroidY);
+    appendColumn(area, other.area);
+    appendColumn(perimeter, other.perimeter);
+    appendColumn(majorAxisLength, other.majorAxisLength);
+    appendColumn(minorAxisLength, other.minorAxisLength);
+    appendColumn(eccentricity, other.eccentricity);
+    appendColumn(solidity, other.solidity);
+    appendColumn(hematoxylinMean, other.hematoxylinMean);
+    appendColumn(hematoxylinStd, other.hematoxylinStd);
+    appendColumn(eosinMean, other.eosinMean);
+    appendColumn(eosinStd, other.eosinStd);
+
+    return;
+  }
+
+
+  static void writeColumnHeader(std::ofstream& file, const char* name, char type)
+  {
+    unsigned int nameLength = std::string(name).size();
+    file.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+    file.write(name, nameLength);
+    file.write(&type, 1);
+  }
+
+
+  template< typename T >
+  static void writeColumnData(std::ofstream& file, const std::vector<T>& column)
+  {
+    if (!column.empty())
+      {
+        file.write(reinterpret_cast<const char*>(&column[0]), column.size()*sizeof(T));
+      }
+  }
+
+
+  void NucleusFeatureTable::write(const std::string& fileName) const
+  {
+    std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary);
+    if (!file)
+      {
+        std::cerr<<"Error: cannot open "<<fileName<<" for writing.\n";
+        abort();
+      }
+
+    const char magic[8] = {'N', 'U', 'C', 'F', 'E', 'A', 'T', 0};
+    unsigned int version = 1;
+    unsigned int numberOfColumns = 14;
+    unsigned long long numberOfRows = label.size();
+
+    file.write(magic, 8);
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char*>(&numberOfColumns), sizeof(numberOfColumns));
+    file.write(reinterpret_cast<const char*>(&numberOfRows), sizeof(numberOfRows));
+
+    writeColumnHeader(file, "tileIndex", 'i');
+    writeColumnHeader(file, "label", 'u');
+    writeColumnHeader(file, "centroidX", 'f');
+    writeColumnHeader(file, "centroidY", 'f');
+    writeColumnHeader(file, "area", 'f');
+    writeColumnHeader(file, "perimeter", 'f');
+    writeColumnHeader(file, "majorAxisLength", 'f');
+    writeColumnHeader(file, "minorAxisLength", 'f');
+    writeColumnHeader(file, "eccentricity", 'f');
+    writeColumnHeader(file, "solidity", 'f');
+    writeColumnHeader(file, "hematoxylinMean", 'f');
+    writeColumnHeader(file, "hematoxylinStd", 'f');
+    writeColumnHeader(file, "eosinMean", 'f');
+    writeColumnHeader(file, "eosinStd", 'f');
+
+    writeColumnData(file, tileIndex);
+    writeColumnData(file, label);
+    writeColumnData(file, centroidX);
+    writeColumnData(file, centroidY);
+    writeColumnData(file, area);
+    writeColumnData(file, perimeter);
+    writeColumnData(file, majorAxisLength);
+    writeColumnData(file, minorAxisLength);
+    writeColumnData(file, eccentricity);
+    writeColumnData(file, solidity);
+    writeColumnData(file, hematoxylinMean);
+    writeColumnData(file, hematoxylinStd);
+    writeColumnData(file, eosinMean);
+    writeColumnData(file, eosinStd);
+
+    if (!file)
+      {
+        std::cerr<<"Error: failed writing "<<fileName<<std::endl;
+        abort();
+      }
+
+    return;
+  }
+
+
+  NucleusFeatureEngine::NucleusFeatureEngine()
+  {
+    m_mpp = -1.0;
+
+    m_numberOfThreads = 1;
+
+    m_allDone = false;
+
+    return;
+  }
+
+
+  void NucleusFeatureEngine::setMPP(float mpp)
+  {
+    if (mpp > 0)
+      {
+        m_mpp = mpp;
+      }
+    else
+      {
+        std::cerr<<"Error: mpp should be > 0. But got "<<mpp<<std::endl;
+      }
+
+    return;
+  }
+
+
+  void NucleusFeatureEngine::addTile(const LabelType* labels, const unsigned char* hematoxylin, const unsigned char* eosin,
+                                     long nx, long ny, long originX, long originY)
+  {
+    Tile tile;
+    tile.labels = labels;
+    tile.hematoxylin = hematoxylin;
+    tile.eosin = eosin;
+    tile.nx = nx;
+    tile.ny = ny;
+    tile.originX = originX;
+    tile.originY = originY;
+
+    m_tiles.push_back(tile);
+    m_allDone = false;
+
+    return;
+  }
+
+
+  void NucleusFeatureEngine::update()
+  {
+    if (m_mpp < 0)
+      {
+        std::cerr<<"ERROR: mpp not set yet.\n";
+        abort();
+      }
+
+    std::vector<NucleusFeatureTable> tables(m_tiles.size());
+
+    if (1 == m_numberOfThreads)
+      {
+        for (std::size_t it = 0; it < m_tiles.size(); ++it)
+          {
+            computeTileFeatures(m_tiles[it], it, m_mpp, tables[it]);
+          }
+      }
+    else
+      {
+        cv::parallel_for_(cv::Range(0, static_cast<int>(m_tiles.size())), NucleusFeatureBody(m_tiles, tables, m_mpp));
+      }
+
+    /// In the order of the tiles, so the output does not depend on the threading
+    m_featureTable.clear();
+    for (std::size_t it = 0; it < tables.size(); ++it)
+      {
+        m_featureTable.append(tables[it]);
+      }
+
+    m_allDone = true;
+
+    return;
+  }
+
+
+  const NucleusFeatureTable& NucleusFeatureEngine::getFeatureTable()
+  {
+    if (!m_allDone)
+      {
+        std::cerr<<"Error: computation not done.\n";
+        abort();
+      }
+
+    return m_featureTable;
+  }
+
+}// namespace gth818n
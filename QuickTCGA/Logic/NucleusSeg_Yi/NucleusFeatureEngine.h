@@ -0,0 +1,119 @@
+#ifndef NucleusFeatureEngine_h_
+#define NucleusFeatureEngine_h_
+
+#include <string>
+#include <vector>
+
+
+namespace gth818n
+{
+  /**
+   * Per-nucleus features, one column per feature, one row per nucleus.
+   *
+   * write() saves the columns one after another:
+   *
+   *   char[8]  "NUCFEAT" and a 0
+   *   uint32   version (1)
+   *   uint32   number of columns
+   *   uint64   number of rows
+   *   per column: uint32 name length, the name, one char type: 'i'
+   *               int32, 'u' uint32, 'f' float32
+   *   per column: the number of rows values
+   *
+   * all in the byte order of the machine that wrote it.
+   */
+  struct NucleusFeatureTable
+  {
+    std::vector<int> tileIndex; ///< in the order the tiles were added
+    std::vector<unsigned int> label; ///< in the label image of the tile
+    std::vector<float> centroidX; ///< pixels, tile origin + centroid in the tile
+    std::vector<float> centroidY;
+    std::vector<float> area; ///< um^2
+    std::vector<float> perimeter; ///< um, Crofton formula as LabelShapeAttributes2D
+    std::vector<float> majorAxisLength; ///< um, of the ellipse with the same second moments
+    std::vector<float> minorAxisLength;
+    std::vector<float> eccentricity;
+    std::vector<float> solidity; ///< area/(area of the convex hull of the pixels)
+    std::vector<float> hematoxylinMean;
+    std::vector<float> hematoxylinStd;
+    std::vector<float> eosinMean; ///< 0 if no eosin channel
+    std::vector<float> eosinStd;
+
+    long size() const {return static_cast<long>(label.size());}
+    void clear();
+    void append(const NucleusFeatureTable& other);
+    void write(const std::string& fileName) const;
+  };
+
+
+  class NucleusFeatureEngine
+  {
+  public:
+    ////////////////////////////////////////////////////////////////////////////////
+    /// ctor
+    NucleusFeatureEngine();
+    ~NucleusFeatureEngine() {}
+    /// ctor, end
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    /// typedef
+    typedef unsigned int LabelType;
+    /// typedef, end
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    /// public fn
+    void setMPP(float mpp);
+    void setNumberOfThreads(int n) {m_numberOfThreads = n;} ///< 1 (default): one tile after another. Otherwise tiles in parallel, same output
+
+    /// Images of nx x ny pixels, row by row. Label 0 is background; the
+    /// labels need not be consecutive. eosin may be 0. The buffers are
+    /// not copied, they must stay valid until update() returns.
+    void addTile(const LabelType* labels, const unsigned char* hematoxylin, const unsigned char* eosin,
+                 long nx, long ny, long originX, long originY);
+
+    void update();
+
+    const NucleusFeatureTable& getFeatureTable();
+    /// public fn, end
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    /// One tile, as given to addTile
+    struct Tile
+    {
+      const LabelType* labels;
+      const unsigned char* hematoxylin;
+      const unsigned char* eosin;
+      long nx;
+      long ny;
+      long originX;
+      long originY;
+    };
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////////
+    /// private data
+    float m_mpp; ///< Micron Per Pixel
+
+    int m_numberOfThreads;
+
+    std::vector<Tile> m_tiles;
+
+    NucleusFeatureTable m_featureTable;
+
+    bool m_allDone;
+    /// private data, end
+    ////////////////////////////////////////////////////////////////////////////////
+  };
+
+}// namespace gth818n
+
+
+#endif // NucleusFeatureEngine_h_
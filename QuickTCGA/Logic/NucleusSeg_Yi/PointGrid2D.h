@@ -0,0 +1,508 @@
+#ifndef PointGrid2D_h_
+#define PointGrid2D_h_
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+
+namespace gth818n
+{
+  /**
+   * Uniform bucket grid over a set of 2D points, for fixed radius
+   * neighbor queries.
+   *
+   * The points are sorted by cell, so the points of a cell are
+   * contiguous. With the cell size equal to the query radius, a query
+   * scans the 3x3 cells around the query point.
+   */
+  template< typename TCoordRep >
+  class PointGrid2D
+  {
+  public:
+    //------------------------------------------------------------------------------
+    /// ctor
+    PointGrid2D();
+    ~PointGrid2D() {}
+    /// ctor, end
+    //------------------------------------------------------------------------------
+
+
+    //------------------------------------------------------------------------------
+    /// public fn
+    /// Bucket the n points (x[i], y[i]). The cell size may be enlarged
+    /// so that the number of cells stays in O(n).
+    void build(const TCoordRep* x, const TCoordRep* y, long n, double cellSize);
+
+    long size() const {return static_cast<long>(m_id.size());}
+
+    /// Number of points within radius of (qx, qy), and the sum of their
+    /// coordinates
+    long sumInRadius(double qx, double qy, double radius, double& sumX, double& sumY) const;
+
+    /// Index, in the input of build(), of the point closest to (qx,
+    /// qy); the smallest index on ties. -1 if there is no point.
+    long nearestPoint(double qx, double qy) const;
+    /// public fn, end
+    //------------------------------------------------------------------------------
+
+
+  private:
+    double m_x0;
+    double m_y0;
+    double m_cellSize;
+
+    long m_nx;
+    long m_ny;
+
+    std::vector<long> m_cellStart; ///< points of cell c are [m_cellStart[c], m_cellStart[c + 1])
+
+    std::vector<TCoordRep> m_x; ///< sorted by cell
+    std::vector<TCoordRep> m_y;
+    std::vector<long> m_id; ///< index of the point in the input of build()
+
+    /// build() buffers, kept so that rebuilding the grid does not allocate
+    std::vector<long> m_cellOfPoint;
+    std::vector<long> m_next;
+
+    /// Range of cells covering [x0, x1] x [y0, y1], clamped to the grid.
+    /// Return false if it does not intersect the grid.
+    bool _cellRange(double x0, double y0, double x1, double y1, long& cx0, long& cy0, long& cx1, long& cy1) const;
+
+    /// Update (nearest, nearestDist2) with the points of cells [cx0, cx1] of row cy
+    void _nearestInCells(double qx, double qy, long cy, long cx0, long cx1, long& nearest, double& nearestDist2) const;
+  };
+
+
+  template< typename TCoordRep >
+  PointGrid2D<TCoordRep>::PointGrid2D()
+  {
+    m_x0 = 0;
+    m_y0 = 0;
+    m_cellSize = 1;
+    m_nx = 0;
+    m_ny = 0;
+  }
+
+
+  template< typename TCoordRep >
+  void PointGrid2D<TCoordRep>::build(const TCoordRep* x, const TCoordRep* y, long n, double cellSize)
+  {
+    m_x.resize(n);
+    m_y.resize(n);
+    m_id.resize(n);
+
+    if (0 == n)
+      {
+        m_nx = 0;
+        m_ny = 0;
+        m_cellStart.assign(1, 0);
+        return;
+      }
+
+    double xMin = x[0];
+    double xMax = x[0];
+    double yMin = y[0];
+    double yMax = y[0];
+
+    for (long i = 1; i < n; ++i)
+      {
+        xMin = xMin<x[i]?xMin:x[i];
+        xMax = xMax>x[i]?xMax:x[i];
+        yMin = yMin<y[i]?yMin:y[i];
+        yMax = yMax>y[i]?yMax:y[i];
+      }
+
+    m_x0 = xMin;
+    m_y0 = yMin;
+    m_cellSize = cellSize;
+
+    /// Sparse points with a small radius would give far more cells than
+    /// points. Larger cells only make the queries scan more points.
+    for (;;)
+      {
+        m_nx = static_cast<long>((xMax - xMin)/m_cellSize) + 1;
+        m_ny = static_cast<long>((yMax - yMin)/m_cellSize) + 1;
+
+        if (m_nx*m_ny <= 4*n + 64)
+          {
+            break;
+          }
+
+        m_cellSize *= 2.0;
+      }
+
+    /// Counting sort of the points by cell
+    m_cellOfPoint.resize(n);
+    m_cellStart.assign(m_nx*m_ny + 1, 0);
+
+    for (long i = 0; i < n; ++i)
+      {
+        long cx = static_cast<long>((x[i] - m_x0)/m_cellSize);
+        long cy = static_cast<long>((y[i] - m_y0)/m_cellSize);
+
+        m_cellOfPoint[i] = cy*m_nx + cx;
+        ++m_cellStart[m_cellOfPoint[i] + 1];
+      }
+
+    for (long c = 0; c < m_nx*m_ny; ++c)
+      {
+        m_cellStart[c + 1] += m_cellStart[c];
+      }
+
+    m_next.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+
+    for (long i = 0; i < n; ++i)
+      {
+        long j = m_next[m_cellOfPoint[i]]++;
+
+        m_x[j] = x[i];
+        m_y[j] = y[i];
+        m_id[j] = i;
+      }
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  bool PointGrid2D<TCoordRep>::_cellRange(double x0, double y0, double x1, double y1, long& cx0, long& cy0, long& cx1, long& cy1) const
+  {
+    if (0 == m_nx)
+      {
+        return false;
+      }
+
+    cx0 = static_cast<long>(std::floor((x0 - m_x0)/m_cellSize));
+    cy0 = static_cast<long>(std::floor((y0 - m_y0)/m_cellSize));
+    cx1 = static_cast<long>(std::floor((x1 - m_x0)/m_cellSize));
+    cy1 = static_cast<long>(std::floor((y1 - m_y0)/m_cellSize));
+
+    cx0 = cx0>0?cx0:0;
+    cy0 = cy0>0?cy0:0;
+    cx1 = cx1<m_nx-1?cx1:m_nx-1;
+    cy1 = cy1<m_ny-1?cy1:m_ny-1;
+
+    return cx0 <= cx1 && cy0 <= cy1;
+  }
+
+
+  template< typename TCoordRep >
+  long PointGrid2D<TCoordRep>::sumInRadius(double qx, double qy, double radius, double& sumX, double& sumY) const
+  {
+    sumX = 0;
+    sumY = 0;
+
+    long cx0, cy0, cx1, cy1;
+    if (!_cellRange(qx - radius, qy - radius, qx + radius, qy + radius, cx0, cy0, cx1, cy1))
+      {
+        return 0;
+      }
+
+    double r2 = radius*radius;
+    long count = 0;
+
+    for (long cy = cy0; cy <= cy1; ++cy)
+      {
+        /// the cells of a row are adjacent, so are their points
+        long begin = m_cellStart[cy*m_nx + cx0];
+        long end = m_cellStart[cy*m_nx + cx1 + 1];
+
+        for (long j = begin; j < end; ++j)
+          {
+            double dx = m_x[j] - qx;
+            double dy = m_y[j] - qy;
+
+            bool inside = dx*dx + dy*dy <= r2;
+
+            count += inside;
+            sumX += inside?m_x[j]:0;
+            sumY += inside?m_y[j]:0;
+          }
+      }
+
+    return count;
+  }
+
+
+  template< typename TCoordRep >
+  void PointGrid2D<TCoordRep>::_nearestInCells(double qx, double qy, long cy, long cx0, long cx1, long& nearest, double& nearestDist2) const
+  {
+    long begin = m_cellStart[cy*m_nx + cx0];
+    long end = m_cellStart[cy*m_nx + cx1 + 1];
+
+    for (long j = begin; j < end; ++j)
+      {
+        double dx = m_x[j] - qx;
+        double dy = m_y[j] - qy;
+        double d2 = dx*dx + dy*dy;
+
+        if (d2 < nearestDist2 || (d2 == nearestDist2 && m_id[j] < nearest))
+          {
+            nearest = m_id[j];
+            nearestDist2 = d2;
+          }
+      }
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  long PointGrid2D<TCoordRep>::nearestPoint(double qx, double qy) const
+  {
+    if (m_id.empty())
+      {
+        return -1;
+      }
+
+    /// Scan rings of cells around the cell of the query point, clamped
+    /// to the grid. The points beyond ring k are at least k cells away.
+    long cx = static_cast<long>(std::floor((qx - m_x0)/m_cellSize));
+    long cy = static_cast<long>(std::floor((qy - m_y0)/m_cellSize));
+
+    cx = cx>0?cx:0;
+    cy = cy>0?cy:0;
+    cx = cx<m_nx-1?cx:m_nx-1;
+    cy = cy<m_ny-1?cy:m_ny-1;
+
+    long nearest = -1;
+    double nearestDist2 = std::numeric_limits<double>::max();
+
+    for (long k = 0; ; ++k)
+      {
+        if (cx - k < 0 && cx + k > m_nx - 1 && cy - k < 0 && cy + k > m_ny - 1)
+          {
+            /// the ring is outside the grid: all cells have been scanned
+            break;
+          }
+
+        long cx0 = cx - k>0?cx - k:0;
+        long cx1 = cx + k<m_nx-1?cx + k:m_nx-1;
+        long cy0 = cy - k>0?cy - k:0;
+        long cy1 = cy + k<m_ny-1?cy + k:m_ny-1;
+
+        for (long iy = cy0; iy <= cy1; ++iy)
+          {
+            if (iy == cy - k || iy == cy + k)
+              {
+                _nearestInCells(qx, qy, iy, cx0, cx1, nearest, nearestDist2);
+              }
+            else
+              {
+                if (cx - k >= 0)
+                  {
+                    _nearestInCells(qx, qy, iy, cx - k, cx - k, nearest, nearestDist2);
+                  }
+                if (cx + k <= m_nx - 1)
+                  {
+                    _nearestInCells(qx, qy, iy, cx + k, cx + k, nearest, nearestDist2);
+                  }
+              }
+          }
+
+        double bound = k*m_cellSize;
+        if (nearest >= 0 && nearestDist2 < bound*bound)
+          {
+            break;
+          }
+      }
+
+    return nearest;
+  }
+
+
+  /**
+   * Mean shift centers bucketed in a grid of cells at least radius
+   * wide, so that the centers within radius of a point are in the 3x3
+   * cells around it.
+   *
+   * Centers are added one at a time, greedily: a candidate is kept
+   * unless an existing center is closer than radius. Then every
+   * candidate is within radius of a center, and its nearest center is
+   * found in the 3x3 cells too.
+   */
+  template< typename TCoordRep >
+  class CenterGrid2D
+  {
+  public:
+    //------------------------------------------------------------------------------
+    /// ctor
+    CenterGrid2D();
+    ~CenterGrid2D() {}
+    /// ctor, end
+    //------------------------------------------------------------------------------
+
+
+    //------------------------------------------------------------------------------
+    /// public fn
+    /// Empty grid for up to maxNumberOfCenters centers. All the points
+    /// passed later must be in [xMin, xMax] x [yMin, yMax].
+    void initialize(double xMin, double yMin, double xMax, double yMax, double radius, long maxNumberOfCenters);
+
+    /// Add (x, y) as a center, unless an existing center is closer than
+    /// radius. Return whether it was added.
+    bool addIfNoCenterWithinRadius(TCoordRep x, TCoordRep y);
+
+    /// Index, in the order of addition, of the center closest to (x,
+    /// y); the first one on ties. -1 if there is none within the 3x3
+    /// cells.
+    long nearestCenter(TCoordRep x, TCoordRep y) const;
+
+    long size() const {return static_cast<long>(m_x.size());}
+    /// public fn, end
+    //------------------------------------------------------------------------------
+
+
+  private:
+    double m_x0;
+    double m_y0;
+    double m_cellSize;
+    double m_radius;
+
+    long m_nx;
+    long m_ny;
+
+    std::vector<long> m_head; ///< per cell, last center added in it, or -1
+    std::vector<long> m_next; ///< per center, previous center of the same cell, or -1
+
+    std::vector<TCoordRep> m_x;
+    std::vector<TCoordRep> m_y;
+
+    long _cellX(double x) const;
+    long _cellY(double y) const;
+  };
+
+
+  template< typename TCoordRep >
+  CenterGrid2D<TCoordRep>::CenterGrid2D()
+  {
+    m_x0 = 0;
+    m_y0 = 0;
+    m_cellSize = 1;
+    m_radius = 1;
+    m_nx = 0;
+    m_ny = 0;
+  }
+
+
+  template< typename TCoordRep >
+  void CenterGrid2D<TCoordRep>::initialize(double xMin, double yMin, double xMax, double yMax, double radius, long maxNumberOfCenters)
+  {
+    m_x0 = xMin;
+    m_y0 = yMin;
+    m_radius = radius;
+    m_cellSize = radius;
+
+    for (;;)
+      {
+        m_nx = static_cast<long>((xMax - xMin)/m_cellSize) + 1;
+        m_ny = static_cast<long>((yMax - yMin)/m_cellSize) + 1;
+
+        if (m_nx*m_ny <= 4*maxNumberOfCenters + 64)
+          {
+            break;
+          }
+
+        m_cellSize *= 2.0;
+      }
+
+    m_head.assign(m_nx*m_ny, -1);
+
+    m_next.clear();
+    m_x.clear();
+    m_y.clear();
+
+    return;
+  }
+
+
+  template< typename TCoordRep >
+  long CenterGrid2D<TCoordRep>::_cellX(double x) const
+  {
+    long cx = static_cast<long>(std::floor((x - m_x0)/m_cellSize));
+    cx = cx>0?cx:0;
+    return cx<m_nx-1?cx:m_nx-1;
+  }
+
+
+  template< typename TCoordRep >
+  long CenterGrid2D<TCoordRep>::_cellY(double y) const
+  {
+    long cy = static_cast<long>(std::floor((y - m_y0)/m_cellSize));
+    cy = cy>0?cy:0;
+    return cy<m_ny-1?cy:m_ny-1;
+  }
+
+
+  template< typename TCoordRep >
+  bool CenterGrid2D<TCoordRep>::addIfNoCenterWithinRadius(TCoordRep x, TCoordRep y)
+  {
+    long cx = _cellX(x);
+    long cy = _cellY(y);
+
+    double r2 = m_radius*m_radius;
+
+    for (long iy = (cy>0?cy-1:0); iy <= cy+1 && iy < m_ny; ++iy)
+      {
+        for (long ix = (cx>0?cx-1:0); ix <= cx+1 && ix < m_nx; ++ix)
+          {
+            for (long ic = m_head[iy*m_nx + ix]; ic >= 0; ic = m_next[ic])
+              {
+                double dx = static_cast<double>(x) - m_x[ic];
+                double dy = static_cast<double>(y) - m_y[ic];
+
+                if (dx*dx + dy*dy < r2)
+                  {
+                    return false;
+                  }
+              }
+          }
+      }
+
+    long c = cy*m_nx + cx;
+
+    m_next.push_back(m_head[c]);
+    m_head[c] = static_cast<long>(m_x.size());
+
+    m_x.push_back(x);
+    m_y.push_back(y);
+
+    return true;
+  }
+
+
+  template< typename TCoordRep >
+  long CenterGrid2D<TCoordRep>::nearestCenter(TCoordRep x, TCoordRep y) const
+  {
+    long cx = _cellX(x);
+    long cy = _cellY(y);
+
+    long nearest = -1;
+    double nearestDistance2 = 0;
+
+    for (long iy = (cy>0?cy-1:0); iy <= cy+1 && iy < m_ny; ++iy)
+      {
+        for (long ix = (cx>0?cx-1:0); ix <= cx+1 && ix < m_nx; ++ix)
+          {
+            for (long ic = m_head[iy*m_nx + ix]; ic >= 0; ic = m_next[ic])
+              {
+                double dx = static_cast<double>(x) - m_x[ic];
+                double dy = static_cast<double>(y) - m_y[ic];
+                double d2 = dx*dx + dy*dy;
+
+                if (nearest < 0 || d2 < nearestDistance2 || (d2 == nearestDistance2 && ic < nearest))
+                  {
+                    nearest = ic;
+                    nearestDistance2 = d2;
+                  }
+              }
+          }
+      }
+
+    return nearest;
+  }
+
+}// namespace gth818n
+
+#endif // PointGrid2D_h_
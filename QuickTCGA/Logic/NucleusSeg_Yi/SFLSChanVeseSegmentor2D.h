@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Level Set evolution, global region Chan-Vese
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SFLSChanVeseSegmentor2D_h_
+#define SFLSChanVeseSegmentor2D_h_
+
+#include "SFLSSegmentor2D.h"
+
+#include <list>
+#include <vector>
+
+
+/*----------------------------------------------------------------------
+  Chan-Vese with a single inside mean and a single outside mean over
+  the whole image, instead of the windowed means of
+  CSFLSLocalChanVeseSegmentor2D.
+
+  The inside/outside sums are computed by one full scan after the
+  initialization, and afterwards only updated from the pixels that
+  changed side in the last iteration (m_lIn2out, m_lOut2in). Only Lz
+  nodes change sign in the SFLS update, so the sums stay exact.  */
+template< typename TPixel >
+class CSFLSChanVeseSegmentor2D : public CSFLSSegmentor2D< TPixel >
+{
+public:
+  typedef CSFLSSegmentor2D< TPixel > SuperClassType;
+
+  typedef typename SuperClassType::NodeType NodeType;
+  typedef typename SuperClassType::CSFLSLayer CSFLSLayer;
+
+
+ /*================================================================================
+    ctor */
+  CSFLSChanVeseSegmentor2D() : CSFLSSegmentor2D< TPixel >()
+  {
+    basicInit();
+  }
+
+  void basicInit();
+
+  // data
+  double m_areaIn;
+  double m_areaOut;
+
+  double m_sumIn;
+  double m_sumOut;
+
+  double m_meanIn;
+  double m_meanOut;
+
+  /* ============================================================
+   * functions
+   * ============================================================*/
+  /// Full scan of mp_phi
+  void computeMeans();
+
+  /// Move the pixels of m_lIn2out/m_lOut2in across the sums
+  void updateMeans();
+
+
+  /* ============================================================
+     computeForce    */
+  double computeForceTermsOnLayer(const CSFLSLayer& lz, double* dataTerm, double* kappa);
+
+  void setInflation(float f) {m_globalInflation = f;}
+
+  /// Use these means for the whole evolution instead of those of mp_phi,
+  /// e.g. when mp_img is a crop of a larger image whose means are wanted
+  void setFixedMeans(double meanIn, double meanOut);
+
+
+protected:
+  /// computeMeans before the first iteration, updateMeans after each,
+  /// unless the means are fixed
+  void beforeEvolution();
+  void afterIteration();
+
+
+private:
+  float m_globalInflation;
+
+  bool m_fixedMeans;
+
+  void meansFromSums();
+
+  /// Data term at a pixel, from the image-wide means
+  class DataTermFunctor
+  {
+  public:
+    DataTermFunctor(const TPixel* img, long nx, double meanIn, double meanOut, double inflation)
+      : m_img(img), m_nx(nx), m_meanIn(meanIn), m_meanOut(meanOut), m_inflation(inflation) {}
+
+    double operator()(long ix, long iy) const
+    {
+      double I = m_img[iy*m_nx + ix];
+      return (I - m_meanIn)*(I - m_meanIn) - (I - m_meanOut)*(I - m_meanOut) - m_inflation;
+    }
+
+  private:
+    const TPixel* m_img;
+    long m_nx;
+    double m_meanIn;
+    double m_meanOut;
+    double m_inflation;
+  };
+};
+
+
+#include "SFLSChanVeseSegmentor2D.hxx"
+
+#endif
@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Level Set evolution, global region Chan-Vese
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SFLSChanVeseSegmentor2D_hpp_
+#define SFLSChanVeseSegmentor2D_hpp_
+
+#include "SFLSChanVeseSegmentor2D.h"
+
+#include <algorithm>
+
+
+/* ============================================================
+   basicInit    */
+template< typename TPixel >
+void
+CSFLSChanVeseSegmentor2D< TPixel >
+::basicInit()
+{
+  SuperClassType::basicInit();
+
+  m_areaIn = 0;
+  m_areaOut = 0;
+
+  m_sumIn = 0;
+  m_sumOut = 0;
+
+  m_meanIn = 0;
+  m_meanOut = 0;
+
+  m_globalInflation = 0.0; // pos: inflation; neg: contraction
+
+  m_fixedMeans = false;
+}
+
+
+/* ============================================================
+   setFixedMeans    */
+template< typename TPixel >
+void
+CSFLSChanVeseSegmentor2D< TPixel >
+::setFixedMeans(double meanIn, double meanOut)
+{
+  m_meanIn = meanIn;
+  m_meanOut = meanOut;
+
+  m_fixedMeans = true;
+}
+
+
+/* ============================================================
+   beforeEvolution    */
+template< typename TPixel >
+void
+CSFLSChanVeseSegmentor2D< TPixel >
+::beforeEvolution()
+{
+  if (!m_fixedMeans)
+    {
+      computeMeans();
+    }
+}
+
+
+/* ============================================================
+   afterIteration    */
+template< typename TPixel >
+void
+CSFLSChanVeseSegmentor2D< TPixel >
+::afterIteration()
+{
+  if (!m_fixedMeans)
+    {
+      updateMeans();
+    }
+}
+
+
+/* ============================================================
+   computeForceTermsOnLayer
+   Only reads the means, so strips can call it concurrently.   */
+template< typename TPixel >
+double
+CSFLSChanVeseSegmentor2D< TPixel >
+::computeForceTermsOnLayer(const CSFLSLayer& lz, double* dataTerm, double* kappa)
+{
+  DataTermFunctor dataTermAt(this->mp_img->GetBufferPointer(), this->m_nx, m_meanIn, m_meanOut, m_globalInflation);
+  return this->computeForceTermsWith(lz, dataTermAt, dataTerm, kappa);
+}
+
+
+/* ============================================================
+   computeMeans    */
+template< typename TPixel >
+void
+CSFLSChanVeseSegmentor2D< TPixel >
+::computeMeans()
+{
+  m_areaIn = 0;
+  m_areaOut = 0;
+
+  m_sumIn = 0;
+  m_sumOut = 0;
+
+  const double* phi = this->mp_phi->GetBufferPointer();
+  const TPixel* img = this->mp_img->GetBufferPointer();
+
+  long n = (this->m_nx)*(this->m_ny);
+  for (long i = 0; i < n; ++i)
+    {
+      if (phi[i] <= 0)
+        {
+          ++m_areaIn;
+          m_sumIn += img[i];
+        }
+      else
+        {
+          ++m_areaOut;
+          m_sumOut += img[i];
+        }
+    }
+
+  meansFromSums();
+}
+
+
+/* ============================================================
+   updateMeans    */
+template< typename TPixel >
+void
+CSFLSChanVeseSegmentor2D< TPixel >
+::updateMeans()
+{
+  for (typename CSFLSLayer::const_iterator it = this->m_lIn2out.begin(); it != this->m_lIn2out.end(); ++it)
+    {
+      typename itk::Image<TPixel, 2>::IndexType idx = {{(*it)[0], (*it)[1]}};
+      double v = this->mp_img->GetPixel(idx);
+
+      m_sumIn -= v;
+      --m_areaIn;
+
+      m_sumOut += v;
+      ++m_areaOut;
+    }
+
+  for (typename CSFLSLayer::const_iterator it = this->m_lOut2in.begin(); it != this->m_lOut2in.end(); ++it)
+    {
+      typename itk::Image<TPixel, 2>::IndexType idx = {{(*it)[0], (*it)[1]}};
+      double v = this->mp_img->GetPixel(idx);
+
+      m_sumIn += v;
+      ++m_areaIn;
+
+      m_sumOut -= v;
+      --m_areaOut;
+    }
+
+  meansFromSums();
+}
+
+
+/* ============================================================
+   meansFromSums    */
+template< typename TPixel >
+void
+CSFLSChanVeseSegmentor2D< TPixel >
+::meansFromSums()
+{
+  m_meanIn = m_sumIn/(m_areaIn + vnl_math::eps);
+  m_meanOut = m_sumOut/(m_areaOut + vnl_math::eps);
+}
+
+
+#endif
@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////
+// Batched curvature of a level set function
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SFLSCurvatureKernel_h_
+#define SFLSCurvatureKernel_h_
+
+// itk
+#include "vnl/vnl_math.h"
+
+
+/*----------------------------------------------------------------------
+  A block of 3x3 stencils of phi, stored as one contiguous array per
+  stencil position. push() gathers the stencil of one pixel;
+  computeCurvature() then evaluates the curvature of the whole block
+  in a branch-free loop over the arrays, which the compiler
+  vectorizes.
+
+  phi is a row-major nx by ny buffer (x fastest), as in an itk::Image.
+  On the image border the missing neighbors are replaced by the
+  center value, which zeroes the corresponding derivatives exactly
+  like CSFLSSegmentor2D::computeKappa does, so the results are
+  identical to it.
+
+  Usage:
+    CSFLSCurvatureKernel block;
+    for each front pixel:
+      block.push(phi, nx, ny, ix, iy);
+      if (block.full()) { block.computeCurvature(kappa + i0); i0 += block.size(); block.clear(); }
+    block.computeCurvature(kappa + i0);  */
+class CSFLSCurvatureKernel
+{
+public:
+  enum { BlockSize = 64 };
+
+  CSFLSCurvatureKernel() : m_n(0) {}
+
+  void clear() { m_n = 0; }
+  long size() const { return m_n; }
+  bool full() const { return m_n == BlockSize; }
+
+  void push(const double* phi, long nx, long ny, long ix, long iy)
+  {
+    const double* p = phi + iy*nx + ix;
+
+    bool xok = ix+1 < nx && ix-1 >= 0;
+    bool yok = iy+1 < ny && iy-1 >= 0;
+
+    double c = p[0];
+
+    m_c[m_n] = c;
+    m_xm[m_n] = xok ? p[-1] : c;
+    m_xp[m_n] = xok ? p[1] : c;
+    m_ym[m_n] = yok ? p[-nx] : c;
+    m_yp[m_n] = yok ? p[nx] : c;
+
+    bool xyok = xok && yok;
+    m_pp[m_n] = xyok ? p[nx+1] : c;
+    m_mm[m_n] = xyok ? p[-nx-1] : c;
+    m_pm[m_n] = xyok ? p[-nx+1] : c;
+    m_mp[m_n] = xyok ? p[nx-1] : c;
+
+    ++m_n;
+  }
+
+  /// kappa[i] for the i-th pushed stencil, i < size()
+  void computeCurvature(double* kappa) const
+  {
+    for (long i = 0; i < m_n; ++i)
+      {
+        double dx  = (m_xp[i] - m_xm[i])/2.0;
+        double dxx = m_xp[i] - 2.0*m_c[i] + m_xm[i];
+        double dx2 = dx*dx;
+
+        double dy  = (m_yp[i] - m_ym[i])/2.0;
+        double dyy = m_yp[i] - 2.0*m_c[i] + m_ym[i];
+        double dy2 = dy*dy;
+
+        double dxy = 0.25*(m_pp[i] + m_mm[i] - m_pm[i] - m_mp[i]);
+
+        kappa[i] = (dxx*dy2 + dyy*dx2 - 2*dx*dy*dxy)/(dx2 + dy2 + vnl_math::eps);
+      }
+  }
+
+private:
+  long m_n;
+
+  double m_c[BlockSize];
+  double m_xm[BlockSize]; ///< (ix-1, iy)
+  double m_xp[BlockSize]; ///< (ix+1, iy)
+  double m_ym[BlockSize]; ///< (ix, iy-1)
+  double m_yp[BlockSize]; ///< (ix, iy+1)
+  double m_pp[BlockSize]; ///< (ix+1, iy+1)
+  double m_mm[BlockSize]; ///< (ix-1, iy-1)
+  double m_pm[BlockSize]; ///< (ix+1, iy-1)
+  double m_mp[BlockSize]; ///< (ix-1, iy+1)
+};
+
+
+/// kappa[i] = curvature of phi at (ix[i], iy[i]), for i < n
+inline void computeCurvatures(const double* phi, long nx, long ny, const long* ix, const long* iy, long n, double* kappa)
+{
+  CSFLSCurvatureKernel block;
+
+  for (long i0 = 0; i0 < n; i0 += CSFLSCurvatureKernel::BlockSize)
+    {
+      long i1 = i0 + CSFLSCurvatureKernel::BlockSize < n ? i0 + CSFLSCurvatureKernel::BlockSize : n;
+
+      block.clear();
+      for (long i = i0; i < i1; ++i)
+        {
+          block.push(phi, nx, ny, ix[i], iy[i]);
+        }
+
+      block.computeCurvature(kappa + i0);
+    }
+}
+
+#endif
@@ -0,0 +1,28 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Level Set evolution
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SFLSIterationStats_h_
+#define SFLSIterationStats_h_
+
+/*----------------------------------------------------------------------
+  What one iteration of the sparse-field evolution did. Recorded only
+  when the segmentor's instrumentation is on.  */
+struct CSFLSIterationStats
+{
+  // layer sizes after the iteration
+  unsigned long m_lz;
+  unsigned long m_ln1;
+  unsigned long m_ln2;
+  unsigned long m_lp1;
+  unsigned long m_lp2;
+
+  // pixels which changed side
+  unsigned long m_in2out;
+  unsigned long m_out2in;
+
+  double m_forceSeconds;
+  double m_evolutionSeconds;
+};
+
+#endif
@@ -9,6 +9,7 @@
 #include "SFLSSegmentor2D.h"
 
 #include <list>
+#include <vector>
 
 
 template< typename TPixel >
@@ -60,15 +61,15 @@ public:
    * ============================================================*/
   void computeMeans();
   void computeMeansAt(long ix, long iy);
+  void computeMeansAt(long ix, long iy, double& meanIn, double& meanOut, double& areaIn, double& areaOut);
   //  void updateMeans();
 
   //void doChanVeseSegmentation();
-  void doSegmentation();
 
 
   /* ============================================================
      computeForce    */
-  void computeForce();
+  double computeForceTermsOnLayer(const CSFLSLayer& lz, double* dataTerm, double* kappa);
 
   void setInflation(float f) {m_globalInflation = f;}
 
@@ -76,6 +77,18 @@ public:
 private:
   float m_globalInflation;
 
+  /// Data term at a pixel, from the means of its window
+  class DataTermFunctor
+  {
+  public:
+    DataTermFunctor(CSFLSLocalChanVeseSegmentor2D* segmentor, double inflation) : m_segmentor(segmentor), m_inflation(inflation) {}
+
+    double operator()(long ix, long iy) const;
+
+  private:
+    CSFLSLocalChanVeseSegmentor2D* m_segmentor;
+    double m_inflation;
+  };
 };
 
 
@@ -29,96 +29,57 @@ CSFLSLocalChanVeseSegmentor2D< TPixel >
 
 
 /* ============================================================
-   computeForce    */
+   computeForceTermsOnLayer
+   Only writes dataTerm and kappa, so strips can call it
+   concurrently.   */
 template< typename TPixel >
-void
+double
 CSFLSLocalChanVeseSegmentor2D< TPixel >
-::computeForce()
+::computeForceTermsOnLayer(const CSFLSLayer& lz, double* dataTerm, double* kappa)
 {
-    this->m_force.clear();
-
-    double fmax = -1e10;
-
-    long n = this->m_lz.size();
-    double* kappaOnZeroLS = new double[ n ];
-    double* cvForce = new double[ n ];
-
-  {
-    long i = 0;
-    for (typename CSFLSLayer::iterator itz = this->m_lz.begin(); itz != this->m_lz.end(); ++itz, ++i)
-      {
-        long ix = (*itz)[0];
-        long iy = (*itz)[1];
-
-        typename itk::Image<TPixel, 2>::IndexType idx = {{ix, iy}};
-
-        kappaOnZeroLS[i] = this->computeKappa(ix, iy);
-
-        computeMeansAt(ix, iy);
-
-        double I = this->mp_img->GetPixel(idx);
-        double a = (I - m_meanIn)*(I - m_meanIn) - (I - m_meanOut)*(I - m_meanOut) - m_globalInflation;
-
-        fmax = fabs(a)>fmax?fabs(a):fmax;
-
-        cvForce[i] = a;
-      }
-  }
+  return this->computeForceTermsWith(lz, DataTermFunctor(this, m_globalInflation), dataTerm, kappa);
+}
 
 
-  for (long i = 0; i < n; ++i)
-    {
-      this->m_force.push_back( cvForce[i]/(fmax + 1e-10) +  (this->m_curvatureWeight)*kappaOnZeroLS[i]);
-    }
+template< typename TPixel >
+double
+CSFLSLocalChanVeseSegmentor2D< TPixel >::DataTermFunctor
+::operator()(long ix, long iy) const
+{
+  double meanIn, meanOut, areaIn, areaOut;
+  m_segmentor->computeMeansAt(ix, iy, meanIn, meanOut, areaIn, areaOut);
 
+  typename itk::Image<TPixel, 2>::IndexType idx = {{ix, iy}};
+  double I = m_segmentor->mp_img->GetPixel(idx);
 
-  delete[] kappaOnZeroLS;
-  delete[] cvForce;
+  return (I - meanIn)*(I - meanIn) - (I - meanOut)*(I - meanOut) - m_inflation;
 }
 
 
 /* ============================================================
-   doSegmentation    */
+   computeMeansAt    */
 template< typename TPixel >
 void
 CSFLSLocalChanVeseSegmentor2D< TPixel >
-::doSegmentation()
+::computeMeansAt(long ix, long iy)
 {
-  /*============================================================
-   * From the initial mask, generate: 1. SFLS, 2. mp_label and
-   * 3. mp_phi.
-   */
-  this->initializeSFLS();
-
-  //computeMeans();
-
-  //gth818n::saveAsImage2< double >(mp_phi, "initPhi.nrrd");
-  for (unsigned int it = 0; it < this->m_numIter; ++it)
-    {
-      computeForce();
-
-      this->normalizeForce();
-
-      this->oneStepLevelSetEvolution();
-    }
+  computeMeansAt(ix, iy, m_meanIn, m_meanOut, m_areaIn, m_areaOut);
 }
 
 
-/* ============================================================
-   computeMeansAt    */
 template< typename TPixel >
 void
 CSFLSLocalChanVeseSegmentor2D< TPixel >
-::computeMeansAt(long ix, long iy)
+::computeMeansAt(long ix, long iy, double& meanIn, double& meanOut, double& areaIn, double& areaOut)
 {
   /*----------------------------------------------------------------------
     Compute the local meanIn/Out areaIn/Out at this pixel. */
 
-  m_areaIn = 0;
-  m_areaOut = 0;
+  areaIn = 0;
+  areaOut = 0;
 
-  m_meanIn = 0;
-  m_meanOut = 0;
+  meanIn = 0;
+  meanOut = 0;
 
   for (long iix = ix-m_nbx; iix <= ix+m_nbx; ++iix)
     {
@@ -134,21 +95,21 @@ CSFLSLocalChanVeseSegmentor2D< TPixel >
               if (phi <= 0)
                 {
                   // in
-                  ++m_areaIn;
-                  m_meanIn += imgVal;
+                  ++areaIn;
+                  meanIn += imgVal;
 
                 }
               else
                 {
-                  ++m_areaOut;
-                  m_meanOut += imgVal;;
+                  ++areaOut;
+                  meanOut += imgVal;;
                 }
             }
         }
     }
 
-  m_meanIn /= (m_areaIn + vnl_math::eps);
-  m_meanOut /= (m_areaOut + vnl_math::eps);
+  meanIn /= (areaIn + vnl_math::eps);
+  meanOut /= (areaOut + vnl_math::eps);
 
   return;
 }
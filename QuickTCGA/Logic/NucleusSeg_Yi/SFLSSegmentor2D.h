@@ -8,12 +8,18 @@
 #define SFLSSegmentor2D_h_
 
 #include "SFLS.h"
+#include "SFLSCurvatureKernel.h"
+#include "SFLSIterationStats.h"
 
 #include <list>
+#include <vector>
 
 //itk
 #include "itkImage.h"
 
+// openCV, for the thread pool of the strip-parallel evolution
+#include "opencv2/core/core.hpp"
+
 template< typename TPixel >
 class CSFLSSegmentor2D : public CSFLS
 {
@@ -38,10 +44,38 @@ public:
 
   void setNumIter(unsigned long n);
 
+  /// n == 1 (default): serial evolution. n > 1: evolve the level set
+  /// in horizontal strips on OpenCV's thread pool, about 4 strips per
+  /// thread, on at most n threads at a time. n <= 0: as many as
+  /// cv::getNumThreads().
+  ///
+  /// The strips give the same result for any n != 1, but not quite the
+  /// serial one: where several new Ln1/Lp1 nodes propose a phi for the
+  /// same pixel, the strips keep the phi closest to zero and the serial
+  /// evolution the first proposal. The masks can differ by a few
+  /// boundary pixels.
+  void setNumThreads(int n);
+
+  /// Stop before numIter iterations once the front has stopped moving:
+  /// at most tol*|Lz| pixels switched in/out in each of the last
+  /// m_convergenceWindow iterations. tol <= 0 (default): always run
+  /// numIter iterations.
+  void setConvergenceTolerance(double tol);
+
+  /// Number of iterations actually run by the last doSegmentation()
+  unsigned long getNumIterDone() const { return m_numIterDone; }
+
+  /// Record a CSFLSIterationStats per iteration. Off by default; when
+  /// off it costs one branch per iteration.
+  void setInstrumentation(bool on) { m_instrumentation = on; }
+  const std::vector< CSFLSIterationStats >& getIterationStats() const { return m_iterationStats; }
+
   void setImage(typename ImageType::Pointer img);
   void setMask(typename MaskImageType::Pointer mask);
 
-  virtual void computeForce() = 0;
+  /// m_force = dataTerm/max|dataTerm| + curvatureWeight*kappa on Lz,
+  /// not normalized: see normalizeForce
+  virtual void computeForce();
 
   void normalizeForce();
 
@@ -49,17 +83,65 @@ public:
   //     double minPhi(long ix, long iy, long iz, double level);
   bool getPhiOfTheNbhdWhoIsClosestToZeroLevelInLayerCloserToZeroLevel(long ix, long iy, long iz, double& thePhi);
 
-  void oneStepLevelSetEvolution();
+  /// Move phi(Lz) by m_force/forceDivisor, and update the layers. The
+  /// divisor lets the caller normalize the force here, instead of in
+  /// another scan of m_force.
+  void oneStepLevelSetEvolution(double forceDivisor = 1.0);
+
+  /// Call before the first iteration
+  void resetConvergence();
+
+  /// Append the stats of the iteration which started at tick tStart,
+  /// finished computing the force at tForce and ended at tEnd
+  /// (cv::getTickCount).
+  void recordIterationStats(int64 tStart, int64 tForce, int64 tEnd);
+
+  /// Call after each iteration: count it, and return true if the
+  /// evolution can stop.
+  bool updateConvergence();
 
   void getSFLSFromPhi();
 
   void initializeSFLS() { initializeSFLSFromMask(); }
   void initializeSFLSFromMask();
+  void initializeLayersFromZeroLayer();
+
+  /// Warm start: take over phi, label and layers of a previous
+  /// evolution on the same image, and re-initialize only where mp_mask
+  /// disagrees with it, i.e. where (mask != 0) != (phi <= maskLevel).
+  /// maskLevel is the level at which the previous phi was cut into
+  /// the mask. Inside is phi <= maskLevel everywhere: the band pixels
+  /// take the side of the mask, and the previous Lz nodes are kept only
+  /// where they still separate the two sides, so the front starts on
+  /// the mask boundary. previous is left without phi and label. doSegmentation
+  /// then starts from this state instead of from the mask.
+  void initializeSFLSFromPrevious(Self& previous, double maskLevel);
 
   void initializeLabel();
   void initializePhi();
 
-  virtual void doSegmentation() = 0;
+  /// Evolve from the mask, or from initializeSFLSFromPrevious, for at
+  /// most numIter iterations; serial or in strips as setNumThreads
+  /// says. The subclasses give the data term in computeForceTermsOnLayer,
+  /// and keep their means up to date in beforeEvolution and
+  /// afterIteration.
+  virtual void doSegmentation();
+
+
+  /* ============================================================
+   * strip-parallel evolution         */
+  void distributeLayersToStrips();
+  void gatherLayersFromStrips();
+
+  /// computeForce + normalizeForce + oneStepLevelSetEvolution, strip by
+  /// strip. Records its own iteration stats.
+  void oneStepLevelSetEvolutionInStrips();
+
+  /// Force terms of the nodes of lz: the un-normalized data term and
+  /// the curvature. Return max|dataTerm|. The force is then
+  /// dataTerm/max|dataTerm| + curvatureWeight*kappa. Must not write
+  /// any member: the strips call it concurrently.
+  virtual double computeForceTermsOnLayer(const CSFLSLayer& lz, double* dataTerm, double* kappa) = 0;
 
 
   // geometry
@@ -90,6 +172,40 @@ protected:
 
   unsigned long m_numIter;
 
+  int m_numThreads;
+
+  double m_convergenceTolerance;
+  unsigned long m_convergenceWindow;
+  unsigned long m_numIterDone;
+  unsigned long m_numStillIter;
+
+  bool m_warmStarted;
+
+  bool m_instrumentation;
+  std::vector< CSFLSIterationStats > m_iterationStats;
+
+  /// Data term and curvature of each Lz node in the serial evolution,
+  /// kept across iterations to avoid reallocating them
+  std::vector< double > m_dataTerm;
+  std::vector< double > m_kappa;
+
+  /// Fill m_force as computeForce, return max|m_force|
+  double computeForceAndMaxAbs();
+
+  /// For computeForceTermsOnLayer: one sweep over lz, computing kappa
+  /// block by block with CSFLSCurvatureKernel, and dataTerm[i] =
+  /// dataTermAt(ix, iy). Return max|dataTerm|.
+  template< typename TDataTermFunctor >
+  double computeForceTermsWith(const CSFLSLayer& lz, const TDataTermFunctor& dataTermAt, double* dataTerm, double* kappa);
+
+  /// Called by doSegmentation after the SFLS initialization, before the
+  /// first iteration
+  virtual void beforeEvolution() {}
+
+  /// Called by doSegmentation after each iteration, when m_lIn2out and
+  /// m_lOut2in hold the Lz pixels which changed side
+  virtual void afterIteration() {}
+
 
   inline bool doubleEqual(double a, double b, double eps = 1e-10)
   {
@@ -107,6 +223,90 @@ protected:
   CSFLSLayer m_lOut2in;
 
 
+  /*----------------------------------------------------------------------
+    Strip-parallel evolution
+
+    Each strip owns the layer nodes whose row is in [m_yBegin,
+    m_yEnd). A node never changes pixel, so it never changes strip,
+    except for the new Ln2/Lp2 nodes created around new Ln1/Lp1
+    nodes: those are proposed to the strip owning the target pixel
+    (m_proposals, or the halo lists for the strips above and below)
+    and taken by that strip in a later stage. When several new
+    Ln1/Lp1 nodes propose the same pixel, the phi closest to zero
+    wins, so the result does not depend on the number of strips (the
+    serial evolution keeps the first proposal instead). */
+  struct ProposalType
+  {
+    long m_ix;
+    long m_iy;
+    double m_phi;
+  };
+
+  struct StripType : public CSFLS
+  {
+    long m_yBegin;
+    long m_yEnd;
+
+    CSFLSLayer m_Sz;
+    CSFLSLayer m_Sn1;
+    CSFLSLayer m_Sp1;
+    CSFLSLayer m_Sn2;
+    CSFLSLayer m_Sp2;
+    CSFLSLayer m_dropped; ///< Ln2/Lp2 nodes leaving the band, label set later
+
+    CSFLSLayer m_lIn2out;
+    CSFLSLayer m_lOut2in;
+
+    std::vector< double > m_dataTerm;
+    std::vector< double > m_kappa;
+    std::vector< double > m_force;
+    double m_maxAbsDataTerm;
+    double m_maxAbsForce;
+
+    std::vector< ProposalType > m_proposals;
+    std::vector< ProposalType > m_proposalsUp; ///< to the strip above (smaller y)
+    std::vector< ProposalType > m_proposalsDown; ///< to the strip below
+  };
+
+  std::vector< StripType > m_strips;
+  long m_stripHeight;
+
+  double m_maxAbsDataTerm;
+  double m_maxAbsForce;
+
+  typedef void (Self::*StripMethodType)(long);
+
+  class StripLoopBody : public cv::ParallelLoopBody
+  {
+  public:
+    StripLoopBody(Self* segmentor, StripMethodType method) : m_segmentor(segmentor), m_method(method) {}
+
+    virtual void operator()(const cv::Range& range) const
+    {
+      for (int is = range.start; is < range.end; ++is)
+        {
+          (m_segmentor->*m_method)(is);
+        }
+    }
+
+  private:
+    Self* m_segmentor;
+    StripMethodType m_method;
+  };
+
+  void runOnStrips(StripMethodType method);
+  void proposeNeighbor(long is, long ix, long iy, double phi);
+
+  // stages of oneStepLevelSetEvolutionInStrips, one strip each
+  void stripComputeForceTerms(long is);
+  void stripCombineForce(long is);
+  void stripEvolveZeroLayer(long is);
+  void stripEvolveLayers1(long is);
+  void stripEvolveLayers2(long is);
+  void stripRelabelAndPropose(long is);
+  void stripTakeProposals(long is);
+
+
   //     //debug//
   //     void labelsCoherentCheck();
   //     void labelsCoherentCheck1();
@@ -35,6 +35,17 @@ CSFLSSegmentor2D< TPixel >
 
   m_curvatureWeight = 0.0;
 
+  m_numThreads = 1;
+  m_stripHeight = 0;
+
+  m_convergenceTolerance = 0.0;
+  m_convergenceWindow = 5;
+  m_numIterDone = 0;
+  m_numStillIter = 0;
+
+  m_warmStarted = false;
+
+  m_instrumentation = false;
 
   m_nx = 0;
   m_ny = 0;
@@ -50,6 +61,110 @@ CSFLSSegmentor2D< TPixel >
   m_numIter = n;
 }
 
+/* ============================================================
+   setNumThreads    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::setNumThreads(int n)
+{
+  m_numThreads = n;
+}
+
+/* ============================================================
+   setConvergenceTolerance    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::setConvergenceTolerance(double tol)
+{
+  m_convergenceTolerance = tol;
+}
+
+/* ============================================================
+   resetConvergence    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::resetConvergence()
+{
+  m_numIterDone = 0;
+  m_numStillIter = 0;
+
+  m_iterationStats.clear();
+}
+
+/* ============================================================
+   recordIterationStats    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::recordIterationStats(int64 tStart, int64 tForce, int64 tEnd)
+{
+  CSFLSIterationStats stats;
+
+  stats.m_lz = m_lz.size();
+  stats.m_ln1 = m_ln1.size();
+  stats.m_ln2 = m_ln2.size();
+  stats.m_lp1 = m_lp1.size();
+  stats.m_lp2 = m_lp2.size();
+  for (std::size_t is = 0; is < m_strips.size(); ++is)
+    {
+      stats.m_lz += m_strips[is].m_lz.size();
+      stats.m_ln1 += m_strips[is].m_ln1.size();
+      stats.m_ln2 += m_strips[is].m_ln2.size();
+      stats.m_lp1 += m_strips[is].m_lp1.size();
+      stats.m_lp2 += m_strips[is].m_lp2.size();
+    }
+
+  stats.m_in2out = m_lIn2out.size();
+  stats.m_out2in = m_lOut2in.size();
+
+  double tickFrequency = cv::getTickFrequency();
+  stats.m_forceSeconds = (tForce - tStart)/tickFrequency;
+  stats.m_evolutionSeconds = (tEnd - tForce)/tickFrequency;
+
+  m_iterationStats.push_back(stats);
+}
+
+/* ============================================================
+   updateConvergence
+
+   The in/out transitions of the last iteration are in m_lIn2out and
+   m_lOut2in. The zero layer is either in m_lz or spread over the
+   strips.  */
+template< typename TPixel >
+bool
+CSFLSSegmentor2D< TPixel >
+::updateConvergence()
+{
+  ++m_numIterDone;
+
+  if (m_convergenceTolerance <= 0)
+    {
+      return false;
+    }
+
+  std::size_t numZeroLayerNodes = m_lz.size();
+  for (std::size_t is = 0; is < m_strips.size(); ++is)
+    {
+      numZeroLayerNodes += m_strips[is].m_lz.size();
+    }
+
+  std::size_t numTransitions = m_lIn2out.size() + m_lOut2in.size();
+
+  if (numTransitions <= m_convergenceTolerance*numZeroLayerNodes)
+    {
+      ++m_numStillIter;
+    }
+  else
+    {
+      m_numStillIter = 0;
+    }
+
+  return m_numStillIter >= m_convergenceWindow;
+}
+
 /* ============================================================
    setCurvatureWeight    */
 template< typename TPixel >
@@ -302,7 +417,7 @@ CSFLSSegmentor2D< TPixel >
 template< typename TPixel >
 void
 CSFLSSegmentor2D< TPixel >
-::oneStepLevelSetEvolution()
+::oneStepLevelSetEvolution(double forceDivisor)
 {
   // create 'changing status' lists
   CSFLSLayer Sz;
@@ -330,7 +445,7 @@ CSFLSSegmentor2D< TPixel >
         typename ImageType::IndexType idx = {{ix, iy}};
 
         double phi_old = mp_phi->GetPixel(idx);
-        double phi_new = phi_old + (*itf);
+        double phi_new = phi_old + (*itf)/forceDivisor;
 
         /*----------------------------------------------------------------------
           Update the lists of pt who change the state, for faster
@@ -690,66 +805,698 @@ CSFLSSegmentor2D< TPixel >
       typename ImageType::IndexType idx1 = {{ix+1, iy}};
       if ( (ix+1 < m_nx) && doubleEqual(mp_phi->GetPixel(idx1), 3.0) )
         {
-          Sp2.push_back(NodeType(ix+1, iy, 0));
-          mp_phi->SetPixel(idx1, mp_phi->GetPixel(idx) + 1 );
+          Sp2.push_back(NodeType(ix+1, iy, 0));
+          mp_phi->SetPixel(idx1, mp_phi->GetPixel(idx) + 1 );
+        }
+
+      typename ImageType::IndexType idx2 = {{ix-1, iy}};
+      if ( (ix-1 >= 0) && doubleEqual(mp_phi->GetPixel(idx2), 3.0) )
+        {
+          Sp2.push_back(NodeType(ix-1, iy, 0));
+          mp_phi->SetPixel(idx2, mp_phi->GetPixel(idx) + 1);
+        }
+    }
+
+
+  //     // debug
+  //     labelsCoherentCheck1();
+
+
+  /*--------------------------------------------------
+    3.4 Scan Sn2     */
+  {
+    //debug
+    int aaa = 0;
+    for (CSFLSLayer::iterator itSn2 = Sn2.begin(); itSn2 != Sn2.end(); ++itSn2, ++aaa)
+      {
+        long ix = (*itSn2)[0];
+        long iy = (*itSn2)[1];
+
+        typename ImageType::IndexType idx = {{ix, iy}};
+
+        m_ln2.push_back(*itSn2);
+
+        mp_label->SetPixel(idx, -2);
+
+        //           // debug
+        //           labelsCoherentCheck1();
+      }
+  }
+
+
+
+  /*--------------------------------------------------
+    3.5 Scan Sp2     */
+  for (CSFLSLayer::iterator itSp2 = Sp2.begin(); itSp2 != Sp2.end(); ++itSp2)
+    {
+      long ix = (*itSp2)[0];
+      long iy = (*itSp2)[1];
+
+      typename ImageType::IndexType idx = {{ix, iy}};
+
+      m_lp2.push_back(*itSp2);
+
+      mp_label->SetPixel(idx, 2);
+    }
+
+
+  //     // debug
+  //     labelsCoherentCheck1();
+
+}
+
+/* ============================================================
+   distributeLayersToStrips
+
+   Cut the domain into horizontal strips and move every layer node
+   into the strip owning its row.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::distributeLayersToStrips()
+{
+  int numThreads = m_numThreads > 0 ? m_numThreads : cv::getNumThreads();
+
+  const long minStripHeight = 8;
+  long numStrips = 4*static_cast<long>(numThreads);
+  numStrips = numStrips<m_ny/minStripHeight?numStrips:m_ny/minStripHeight;
+  numStrips = numStrips>1?numStrips:1;
+
+  m_stripHeight = (m_ny + numStrips - 1)/numStrips;
+  numStrips = (m_ny + m_stripHeight - 1)/m_stripHeight;
+
+  m_strips.clear();
+  m_strips.resize(numStrips);
+
+  for (long is = 0; is < numStrips; ++is)
+    {
+      m_strips[is].m_yBegin = is*m_stripHeight;
+      m_strips[is].m_yEnd = (is + 1)*m_stripHeight<m_ny?(is + 1)*m_stripHeight:m_ny;
+    }
+
+  CSFLSLayer CSFLS::* layers[] = {&CSFLS::m_lz, &CSFLS::m_ln1, &CSFLS::m_ln2, &CSFLS::m_lp1, &CSFLS::m_lp2};
+
+  for (int il = 0; il < 5; ++il)
+    {
+      CSFLSLayer& layer = this->*layers[il];
+
+      while (!layer.empty())
+        {
+          long is = layer.front()[1]/m_stripHeight;
+          CSFLSLayer& stripLayer = m_strips[is].*layers[il];
+          stripLayer.splice(stripLayer.end(), layer, layer.begin());
+        }
+    }
+}
+
+
+/* ============================================================
+   gatherLayersFromStrips
+
+   Merge the strip layers back, in strip order.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::gatherLayersFromStrips()
+{
+  CSFLSLayer CSFLS::* layers[] = {&CSFLS::m_lz, &CSFLS::m_ln1, &CSFLS::m_ln2, &CSFLS::m_lp1, &CSFLS::m_lp2};
+
+  for (int il = 0; il < 5; ++il)
+    {
+      CSFLSLayer& layer = this->*layers[il];
+
+      for (std::size_t is = 0; is < m_strips.size(); ++is)
+        {
+          layer.splice(layer.end(), m_strips[is].*layers[il]);
+        }
+    }
+
+  m_strips.clear();
+}
+
+
+/* ============================================================
+   runOnStrips    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::runOnStrips(StripMethodType method)
+{
+  /// n > 1 stripes: at most n threads at a time, each on a run of
+  /// consecutive strips
+  int numStrips = static_cast<int>(m_strips.size());
+  cv::parallel_for_(cv::Range(0, numStrips), StripLoopBody(this, method), m_numThreads > 1 ? m_numThreads : -1);
+}
+
+
+/* ============================================================
+   oneStepLevelSetEvolutionInStrips
+
+   Same steps as computeForce, normalizeForce and
+   oneStepLevelSetEvolution. Each stage runs on all strips in
+   parallel. A stage only writes pixels of its own strip, and only
+   reads across strip borders values that an earlier stage has
+   finished writing.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::oneStepLevelSetEvolutionInStrips()
+{
+  int64 tStart = m_instrumentation ? cv::getTickCount() : 0;
+
+  runOnStrips(&Self::stripComputeForceTerms);
+
+  m_maxAbsDataTerm = -1e10;
+  for (std::size_t is = 0; is < m_strips.size(); ++is)
+    {
+      m_maxAbsDataTerm = m_maxAbsDataTerm>m_strips[is].m_maxAbsDataTerm?m_maxAbsDataTerm:m_strips[is].m_maxAbsDataTerm;
+    }
+
+  runOnStrips(&Self::stripCombineForce);
+
+  m_maxAbsForce = 0.0;
+  for (std::size_t is = 0; is < m_strips.size(); ++is)
+    {
+      m_maxAbsForce = m_maxAbsForce>m_strips[is].m_maxAbsForce?m_maxAbsForce:m_strips[is].m_maxAbsForce;
+    }
+  m_maxAbsForce /= 0.49;
+
+  int64 tForce = m_instrumentation ? cv::getTickCount() : 0;
+
+  runOnStrips(&Self::stripEvolveZeroLayer);
+  runOnStrips(&Self::stripEvolveLayers1);
+  runOnStrips(&Self::stripEvolveLayers2);
+  runOnStrips(&Self::stripRelabelAndPropose);
+  runOnStrips(&Self::stripTakeProposals);
+
+  m_lIn2out.clear();
+  m_lOut2in.clear();
+  for (std::size_t is = 0; is < m_strips.size(); ++is)
+    {
+      m_lIn2out.splice(m_lIn2out.end(), m_strips[is].m_lIn2out);
+      m_lOut2in.splice(m_lOut2in.end(), m_strips[is].m_lOut2in);
+    }
+
+  if (m_instrumentation)
+    {
+      recordIterationStats(tStart, tForce, cv::getTickCount());
+    }
+}
+
+
+/* ============================================================
+   stripComputeForceTerms    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::stripComputeForceTerms(long is)
+{
+  StripType& strip = m_strips[is];
+
+  long n = strip.m_lz.size();
+  strip.m_dataTerm.resize(n);
+  strip.m_kappa.resize(n);
+  strip.m_maxAbsDataTerm = -1e10;
+
+  if (0 == n)
+    {
+      return;
+    }
+
+  strip.m_maxAbsDataTerm = computeForceTermsOnLayer(strip.m_lz, &strip.m_dataTerm[0], &strip.m_kappa[0]);
+}
+
+
+/* ============================================================
+   stripCombineForce    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::stripCombineForce(long is)
+{
+  StripType& strip = m_strips[is];
+
+  long n = strip.m_lz.size();
+  strip.m_force.resize(n);
+  strip.m_maxAbsForce = 0.0;
+
+  for (long i = 0; i < n; ++i)
+    {
+      double f = strip.m_dataTerm[i]/(m_maxAbsDataTerm + 1e-10) + m_curvatureWeight*strip.m_kappa[i];
+      strip.m_force[i] = f;
+
+      double v = fabs(f);
+      strip.m_maxAbsForce = strip.m_maxAbsForce>v?strip.m_maxAbsForce:v;
+    }
+}
+
+
+/* ============================================================
+   stripEvolveZeroLayer
+   Step 1 of oneStepLevelSetEvolution    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::stripEvolveZeroLayer(long is)
+{
+  StripType& strip = m_strips[is];
+
+  strip.m_lIn2out.clear();
+  strip.m_lOut2in.clear();
+  strip.m_proposals.clear();
+  strip.m_proposalsUp.clear();
+  strip.m_proposalsDown.clear();
+
+  std::vector<double>::const_iterator itf = strip.m_force.begin();
+  for (CSFLSLayer::iterator itz = strip.m_lz.begin(); itz != strip.m_lz.end(); ++itf)
+    {
+      long ix = (*itz)[0];
+      long iy = (*itz)[1];
+
+      typename ImageType::IndexType idx = {{ix, iy}};
+
+      double phi_old = mp_phi->GetPixel(idx);
+      double phi_new = phi_old + (*itf)/(m_maxAbsForce + 1e-10);
+
+      if ( phi_old <= 0 && phi_new > 0 )
+        {
+          strip.m_lIn2out.push_back(NodeType(ix, iy, 0));
+        }
+
+      if( phi_old>0  && phi_new <= 0)
+        {
+          strip.m_lOut2in.push_back(NodeType(ix, iy, 0));
+        }
+
+      mp_phi->SetPixel(idx, phi_new);
+
+      if(phi_new > 0.5)
+        {
+          strip.m_Sp1.push_back(*itz);
+          itz = strip.m_lz.erase(itz);
+        }
+      else if (phi_new < -0.5)
+        {
+          strip.m_Sn1.push_back(*itz);
+          itz = strip.m_lz.erase(itz);
+        }
+      else
+        {
+          ++itz;
+        }
+    }
+}
+
+
+/* ============================================================
+   stripEvolveLayers1
+   Steps 2.1 and 2.2 of oneStepLevelSetEvolution. Ln1 and Lp1 only
+   read the phi of label 0 pixels, which are not written here.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::stripEvolveLayers1(long is)
+{
+  StripType& strip = m_strips[is];
+
+  for (CSFLSLayer::iterator itn1 = strip.m_ln1.begin(); itn1 != strip.m_ln1.end(); )
+    {
+      long ix = (*itn1)[0];
+      long iy = (*itn1)[1];
+
+      typename ImageType::IndexType idx = {{ix, iy}};
+
+      double thePhi;
+      bool found = getPhiOfTheNbhdWhoIsClosestToZeroLevelInLayerCloserToZeroLevel(ix, iy, 0, thePhi);
+
+      if (found)
+        {
+          double phi_new = thePhi-1;
+          mp_phi->SetPixel(idx, phi_new);
+
+          if (phi_new >= -0.5)
+            {
+              strip.m_Sz.push_back(*itn1);
+              itn1 = strip.m_ln1.erase(itn1);
+            }
+          else if (phi_new < -1.5)
+            {
+              strip.m_Sn2.push_back(*itn1);
+              itn1 = strip.m_ln1.erase(itn1);
+            }
+          else
+            {
+              ++itn1;
+            }
+        }
+      else
+        {
+          strip.m_Sn2.push_back(*itn1);
+          itn1 = strip.m_ln1.erase(itn1);
+
+          mp_phi->SetPixel(idx, mp_phi->GetPixel(idx) - 1);
+        }
+    }
+
+  for (CSFLSLayer::iterator itp1 = strip.m_lp1.begin(); itp1 != strip.m_lp1.end(); )
+    {
+      long ix = (*itp1)[0];
+      long iy = (*itp1)[1];
+
+      typename ImageType::IndexType idx = {{ix, iy}};
+
+      double thePhi;
+      bool found = getPhiOfTheNbhdWhoIsClosestToZeroLevelInLayerCloserToZeroLevel(ix, iy, 0, thePhi);
+
+      if (found)
+        {
+          double phi_new = thePhi+1;
+          mp_phi->SetPixel(idx, phi_new);
+
+          if (phi_new <= 0.5)
+            {
+              strip.m_Sz.push_back(*itp1);
+              itp1 = strip.m_lp1.erase(itp1);
+            }
+          else if (phi_new > 1.5)
+            {
+              strip.m_Sp2.push_back(*itp1);
+              itp1 = strip.m_lp1.erase(itp1);
+            }
+          else
+            {
+              ++itp1;
+            }
+        }
+      else
+        {
+          strip.m_Sp2.push_back(*itp1);
+          itp1 = strip.m_lp1.erase(itp1);
+
+          mp_phi->SetPixel(idx, mp_phi->GetPixel(idx) + 1);
+        }
+    }
+}
+
+
+/* ============================================================
+   stripEvolveLayers2
+   Steps 2.3 and 2.4 of oneStepLevelSetEvolution. The label of the
+   nodes leaving the band is set in stripRelabelAndPropose, because
+   the neighbor strips are reading labels now.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::stripEvolveLayers2(long is)
+{
+  StripType& strip = m_strips[is];
+
+  for (CSFLSLayer::iterator itn2 = strip.m_ln2.begin(); itn2 != strip.m_ln2.end(); )
+    {
+      long ix = (*itn2)[0];
+      long iy = (*itn2)[1];
+
+      typename ImageType::IndexType idx = {{ix, iy}};
+
+      double thePhi;
+      bool found = getPhiOfTheNbhdWhoIsClosestToZeroLevelInLayerCloserToZeroLevel(ix, iy, 0, thePhi);
+
+      if (found && thePhi-1 >= -2.5)
+        {
+          double phi_new = thePhi-1;
+          mp_phi->SetPixel(idx, phi_new);
+
+          if (phi_new >= -1.5)
+            {
+              strip.m_Sn1.push_back(*itn2);
+              itn2 = strip.m_ln2.erase(itn2);
+            }
+          else
+            {
+              ++itn2;
+            }
+        }
+      else
+        {
+          mp_phi->SetPixel(idx, -3);
+
+          CSFLSLayer::iterator itNext = itn2;
+          ++itNext;
+          strip.m_dropped.splice(strip.m_dropped.end(), strip.m_ln2, itn2);
+          itn2 = itNext;
+        }
+    }
+
+  for (CSFLSLayer::iterator itp2 = strip.m_lp2.begin(); itp2 != strip.m_lp2.end(); )
+    {
+      long ix = (*itp2)[0];
+      long iy = (*itp2)[1];
+
+      typename ImageType::IndexType idx = {{ix, iy}};
+
+      double thePhi;
+      bool found = getPhiOfTheNbhdWhoIsClosestToZeroLevelInLayerCloserToZeroLevel(ix, iy, 0, thePhi);
+
+      if (found && thePhi+1 <= 2.5)
+        {
+          double phi_new = thePhi+1;
+          mp_phi->SetPixel(idx, phi_new);
+
+          if (phi_new <= 1.5)
+            {
+              strip.m_Sp1.push_back(*itp2);
+              itp2 = strip.m_lp2.erase(itp2);
+            }
+          else
+            {
+              ++itp2;
+            }
+        }
+      else
+        {
+          mp_phi->SetPixel(idx, 3);
+
+          CSFLSLayer::iterator itNext = itp2;
+          ++itNext;
+          strip.m_dropped.splice(strip.m_dropped.end(), strip.m_lp2, itp2);
+          itp2 = itNext;
+        }
+    }
+}
+
+
+/* ============================================================
+   proposeNeighbor
+   Send a new Ln2/Lp2 candidate to the strip owning its row.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::proposeNeighbor(long is, long ix, long iy, double phi)
+{
+  ProposalType p;
+  p.m_ix = ix;
+  p.m_iy = iy;
+  p.m_phi = phi;
+
+  long js = iy/m_stripHeight;
+
+  if (js < is)
+    {
+      m_strips[is].m_proposalsUp.push_back(p);
+    }
+  else if (js > is)
+    {
+      m_strips[is].m_proposalsDown.push_back(p);
+    }
+  else
+    {
+      m_strips[is].m_proposals.push_back(p);
+    }
+}
+
+
+/* ============================================================
+   stripRelabelAndPropose
+   Steps 3.1 to 3.3 of oneStepLevelSetEvolution. The -3/3 neighbors
+   of the new Ln1/Lp1 nodes are only proposed here: they may belong
+   to another strip, and their phi is still being read.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::stripRelabelAndPropose(long is)
+{
+  StripType& strip = m_strips[is];
+
+  for (CSFLSLayer::const_iterator it = strip.m_dropped.begin(); it != strip.m_dropped.end(); ++it)
+    {
+      typename ImageType::IndexType idx = {{(*it)[0], (*it)[1]}};
+      mp_label->SetPixel(idx, mp_phi->GetPixel(idx) > 0 ? 3 : -3);
+    }
+  strip.m_dropped.clear();
+
+  for (CSFLSLayer::const_iterator itSz = strip.m_Sz.begin(); itSz != strip.m_Sz.end(); ++itSz)
+    {
+      typename ImageType::IndexType idx = {{(*itSz)[0], (*itSz)[1]}};
+      mp_label->SetPixel(idx, 0);
+    }
+  strip.m_lz.splice(strip.m_lz.end(), strip.m_Sz);
+
+  for (CSFLSLayer::const_iterator itSn1 = strip.m_Sn1.begin(); itSn1 != strip.m_Sn1.end(); ++itSn1)
+    {
+      long ix = (*itSn1)[0];
+      long iy = (*itSn1)[1];
+
+      typename ImageType::IndexType idx = {{ix, iy}};
+
+      mp_label->SetPixel(idx, -1);
+
+      double phi = mp_phi->GetPixel(idx) - 1;
+
+      typename ImageType::IndexType idx1 = {{ix+1, iy}};
+      if ( (ix+1 < m_nx) && doubleEqual(mp_phi->GetPixel(idx1), -3.0) )
+        {
+          proposeNeighbor(is, ix+1, iy, phi);
+        }
+
+      typename ImageType::IndexType idx2 = {{ix-1, iy}};
+      if ( (ix-1 >= 0) && doubleEqual(mp_phi->GetPixel(idx2), -3.0) )
+        {
+          proposeNeighbor(is, ix-1, iy, phi);
+        }
+
+      typename ImageType::IndexType idx3 = {{ix, iy+1}};
+      if ( (iy+1 < m_ny) && doubleEqual(mp_phi->GetPixel(idx3), -3.0) )
+        {
+          proposeNeighbor(is, ix, iy+1, phi);
+        }
+
+      typename ImageType::IndexType idx4 = {{ix, iy-1}};
+      if ( (iy-1>=0) && doubleEqual(mp_phi->GetPixel(idx4), -3.0) )
+        {
+          proposeNeighbor(is, ix, iy-1, phi);
+        }
+    }
+  strip.m_ln1.splice(strip.m_ln1.end(), strip.m_Sn1);
+
+  for (CSFLSLayer::const_iterator itSp1 = strip.m_Sp1.begin(); itSp1 != strip.m_Sp1.end(); ++itSp1)
+    {
+      long ix = (*itSp1)[0];
+      long iy = (*itSp1)[1];
+
+      typename ImageType::IndexType idx = {{ix, iy}};
+
+      mp_label->SetPixel(idx, 1);
+
+      double phi = mp_phi->GetPixel(idx) + 1;
+
+      typename ImageType::IndexType idx3 = {{ix, iy+1}};
+      if ( (iy+1 < m_ny) && doubleEqual(mp_phi->GetPixel(idx3), 3.0) )
+        {
+          proposeNeighbor(is, ix, iy+1, phi);
+        }
+
+      typename ImageType::IndexType idx4 = {{ix, iy-1}};
+      if ( (iy-1>=0) && doubleEqual(mp_phi->GetPixel(idx4), 3.0) )
+        {
+          proposeNeighbor(is, ix, iy-1, phi);
+        }
+
+      typename ImageType::IndexType idx1 = {{ix+1, iy}};
+      if ( (ix+1 < m_nx) && doubleEqual(mp_phi->GetPixel(idx1), 3.0) )
+        {
+          proposeNeighbor(is, ix+1, iy, phi);
         }
 
       typename ImageType::IndexType idx2 = {{ix-1, iy}};
       if ( (ix-1 >= 0) && doubleEqual(mp_phi->GetPixel(idx2), 3.0) )
         {
-          Sp2.push_back(NodeType(ix-1, iy, 0));
-          mp_phi->SetPixel(idx2, mp_phi->GetPixel(idx) + 1);
+          proposeNeighbor(is, ix-1, iy, phi);
         }
     }
+  strip.m_lp1.splice(strip.m_lp1.end(), strip.m_Sp1);
+}
 
 
-  //     // debug
-  //     labelsCoherentCheck1();
-
-
-  /*--------------------------------------------------
-    3.4 Scan Sn2     */
-  {
-    //debug
-    int aaa = 0;
-    for (CSFLSLayer::iterator itSn2 = Sn2.begin(); itSn2 != Sn2.end(); ++itSn2, ++aaa)
-      {
-        long ix = (*itSn2)[0];
-        long iy = (*itSn2)[1];
-
-        typename ImageType::IndexType idx = {{ix, iy}};
+/* ============================================================
+   stripTakeProposals
+   Steps 3.4 and 3.5 of oneStepLevelSetEvolution. Take the proposals
+   for this strip, from itself first and then from the strips above
+   and below. A pixel proposed several times keeps the phi closest
+   to zero.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::stripTakeProposals(long is)
+{
+  StripType& strip = m_strips[is];
 
-        m_ln2.push_back(*itSn2);
+  const std::vector< ProposalType >* inboxes[3] = {&strip.m_proposals, 0, 0};
+  if (is > 0)
+    {
+      inboxes[1] = &(m_strips[is - 1].m_proposalsDown);
+    }
+  if (is + 1 < static_cast<long>(m_strips.size()))
+    {
+      inboxes[2] = &(m_strips[is + 1].m_proposalsUp);
+    }
 
-        mp_label->SetPixel(idx, -2);
+  for (int ib = 0; ib < 3; ++ib)
+    {
+      if (!inboxes[ib])
+        {
+          continue;
+        }
 
-        //           // debug
-        //           labelsCoherentCheck1();
-      }
-  }
+      for (std::size_t ip = 0; ip < inboxes[ib]->size(); ++ip)
+        {
+          const ProposalType& p = (*inboxes[ib])[ip];
 
+          typename ImageType::IndexType idx = {{p.m_ix, p.m_iy}};
+          double phi = mp_phi->GetPixel(idx);
 
+          if (p.m_phi < 0)
+            {
+              if (doubleEqual(phi, -3.0))
+                {
+                  mp_phi->SetPixel(idx, p.m_phi);
+                  strip.m_Sn2.push_back(NodeType(p.m_ix, p.m_iy, 0));
+                }
+              else if (p.m_phi > phi)
+                {
+                  mp_phi->SetPixel(idx, p.m_phi);
+                }
+            }
+          else
+            {
+              if (doubleEqual(phi, 3.0))
+                {
+                  mp_phi->SetPixel(idx, p.m_phi);
+                  strip.m_Sp2.push_back(NodeType(p.m_ix, p.m_iy, 0));
+                }
+              else if (p.m_phi < phi)
+                {
+                  mp_phi->SetPixel(idx, p.m_phi);
+                }
+            }
+        }
+    }
 
-  /*--------------------------------------------------
-    3.5 Scan Sp2     */
-  for (CSFLSLayer::iterator itSp2 = Sp2.begin(); itSp2 != Sp2.end(); ++itSp2)
+  for (CSFLSLayer::const_iterator itSn2 = strip.m_Sn2.begin(); itSn2 != strip.m_Sn2.end(); ++itSn2)
     {
-      long ix = (*itSp2)[0];
-      long iy = (*itSp2)[1];
-
-      typename ImageType::IndexType idx = {{ix, iy}};
-
-      m_lp2.push_back(*itSp2);
+      typename ImageType::IndexType idx = {{(*itSn2)[0], (*itSn2)[1]}};
+      mp_label->SetPixel(idx, -2);
+    }
+  strip.m_ln2.splice(strip.m_ln2.end(), strip.m_Sn2);
 
+  for (CSFLSLayer::const_iterator itSp2 = strip.m_Sp2.begin(); itSp2 != strip.m_Sp2.end(); ++itSp2)
+    {
+      typename ImageType::IndexType idx = {{(*itSp2)[0], (*itSp2)[1]}};
       mp_label->SetPixel(idx, 2);
     }
-
-
-  //     // debug
-  //     labelsCoherentCheck1();
-
+  strip.m_lp2.splice(strip.m_lp2.end(), strip.m_Sp2);
 }
 
+
 /*================================================================================
   initializeLabel*/
 template< typename TPixel >
@@ -870,6 +1617,20 @@ CSFLSSegmentor2D< TPixel >
     }
 
 
+  initializeLayersFromZeroLayer();
+}
+
+
+/* ============================================================
+   initializeLayersFromZeroLayer
+
+   Given Lz, and label/phi = -3/3 everywhere else, create Ln1, Lp1,
+   Ln2 and Lp2.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::initializeLayersFromZeroLayer()
+{
   //scan Lz to create Ln1 and Lp1
   for (CSFLSLayer::const_iterator it = m_lz.begin(); it != m_lz.end(); ++it)
     {
@@ -1050,6 +1811,195 @@ CSFLSSegmentor2D< TPixel >
 }
 
 
+/* ============================================================
+   initializeSFLSFromPrevious
+
+   Inside is phi <= maskLevel throughout, as the mask was cut.
+
+   1. Find the pixels D where the mask disagrees with the previous
+      phi. This is one scan of the buffers.
+   2. Reset Ln1, Ln2, Lp1, Lp2 and D to -3/3 by the mask: e.g. with
+      maskLevel 1 the Lp1 pixels with phi <= 1 go inside.
+   3. Keep the previous Lz nodes not in D, with their phi, if they
+      still have a neighbor on the other side; the others go to -3/3
+      by the mask. Wherever an inside and an outside pixel are
+      neighbors without an Lz node between them (around D, or where
+      the previous band was not tight), the inside one becomes a new
+      Lz node. This is one scan of the label buffer.
+   4. Grow Ln1, Lp1, Ln2 and Lp2 from Lz as in initializeSFLSFromMask.  */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::initializeSFLSFromPrevious(Self& previous, double maskLevel)
+{
+  if (!mp_mask)
+    {
+      std::cerr<<"set mp_mask first.\n";
+      raise(SIGABRT);
+    }
+
+  if (!previous.mp_phi || !previous.mp_label || previous.m_nx != m_nx || previous.m_ny != m_ny)
+    {
+      std::cerr<<"Error: previous evolution does not match the image.\n";
+      raise(SIGABRT);
+    }
+
+  mp_phi = previous.mp_phi;
+  mp_label = previous.mp_label;
+  previous.mp_phi = NULL;
+  previous.mp_label = NULL;
+
+  m_lz.clear();
+  m_ln1.clear();
+  m_ln2.clear();
+  m_lp1.clear();
+  m_lp2.clear();
+  m_lz.splice(m_lz.end(), previous.m_lz);
+
+  double* phi = mp_phi->GetBufferPointer();
+  char* label = mp_label->GetBufferPointer();
+  const typename MaskImageType::PixelType* mask = mp_mask->GetBufferPointer();
+
+  // 1.
+  std::vector< long > changed;
+  long n = m_nx*m_ny;
+  for (long i = 0; i < n; ++i)
+    {
+      if ((mask[i] != 0) != (phi[i] <= maskLevel))
+        {
+          changed.push_back(i);
+        }
+    }
+
+  // 2.
+  CSFLSLayer* bands[] = {&previous.m_ln1, &previous.m_ln2, &previous.m_lp1, &previous.m_lp2};
+  for (int il = 0; il < 4; ++il)
+    {
+      for (CSFLSLayer::const_iterator it = bands[il]->begin(); it != bands[il]->end(); ++it)
+        {
+          long i = (*it)[1]*m_nx + (*it)[0];
+          label[i] = mask[i] != 0 ? -3 : 3;
+          phi[i] = label[i];
+        }
+
+      bands[il]->clear();
+    }
+
+  for (std::size_t ic = 0; ic < changed.size(); ++ic)
+    {
+      long i = changed[ic];
+      label[i] = mask[i] != 0 ? -3 : 3;
+      phi[i] = label[i];
+    }
+
+  // 3.
+  for (CSFLSLayer::iterator it = m_lz.begin(); it != m_lz.end(); )
+    {
+      if (label[(*it)[1]*m_nx + (*it)[0]] != 0)
+        {
+          it = m_lz.erase(it);
+        }
+      else
+        {
+          ++it;
+        }
+    }
+
+  // Lz nodes with all their neighbors on their side of the cut are not
+  // on the front any more. Dropping one does not change its side, so
+  // the test does not depend on the order.
+  std::vector< long > stale;
+  for (CSFLSLayer::const_iterator it = m_lz.begin(); it != m_lz.end(); ++it)
+    {
+      long ix = (*it)[0];
+      long iy = (*it)[1];
+      long i = iy*m_nx + ix;
+      bool inside = phi[i] <= maskLevel;
+
+      long neighbors[4] = {ix > 0 ? i-1 : -1, ix+1 < m_nx ? i+1 : -1, iy > 0 ? i-m_nx : -1, iy+1 < m_ny ? i+m_nx : -1};
+
+      bool onFront = false;
+      for (int k = 0; k < 4 && !onFront; ++k)
+        {
+          long j = neighbors[k];
+          if (j >= 0)
+            {
+              bool neighborInside = label[j] != 0 ? label[j] < 0 : phi[j] <= maskLevel;
+              onFront = neighborInside != inside;
+            }
+        }
+
+      if (!onFront)
+        {
+          stale.push_back(i);
+        }
+    }
+  std::sort(stale.begin(), stale.end());
+
+  for (CSFLSLayer::iterator it = m_lz.begin(); it != m_lz.end(); )
+    {
+      long i = (*it)[1]*m_nx + (*it)[0];
+      if (std::binary_search(stale.begin(), stale.end(), i))
+        {
+          it = m_lz.erase(it);
+        }
+      else
+        {
+          ++it;
+        }
+    }
+
+  for (std::size_t is = 0; is < stale.size(); ++is)
+    {
+      long i = stale[is];
+      label[i] = mask[i] != 0 ? -3 : 3;
+      phi[i] = label[i];
+    }
+
+  for (long iy = 0; iy < m_ny; ++iy)
+    {
+      for (long ix = 0; ix < m_nx; ++ix)
+        {
+          long i = iy*m_nx + ix;
+
+          if (label[i] == 0)
+            {
+              continue;
+            }
+
+          long neighbors[2] = {ix+1 < m_nx ? i+1 : -1, iy+1 < m_ny ? i+m_nx : -1};
+
+          for (int k = 0; k < 2; ++k)
+            {
+              long j = neighbors[k];
+
+              if (j < 0 || label[j] == 0 || (phi[i] > 0) == (phi[j] > 0))
+                {
+                  continue;
+                }
+
+              long inside = phi[i] > 0 ? j : i;
+
+              m_lz.push_back(NodeType(inside%m_nx, inside/m_nx, 0));
+
+              label[inside] = 0;
+              phi[inside] = 0.0;
+
+              if (inside == i)
+                {
+                  break;
+                }
+            }
+        }
+    }
+
+  // 4.
+  initializeLayersFromZeroLayer();
+
+  m_warmStarted = true;
+}
+
+
 /* ============================================================
    getSFLSFromPhi    */
 template< typename TPixel >
@@ -1521,6 +2471,166 @@ CSFLSSegmentor2D< TPixel >
 }
 
 
+/* ============================================================
+   computeForceTermsWith    */
+template< typename TPixel >
+template< typename TDataTermFunctor >
+double
+CSFLSSegmentor2D< TPixel >
+::computeForceTermsWith(const CSFLSLayer& lz, const TDataTermFunctor& dataTermAt, double* dataTerm, double* kappa)
+{
+  const double* phi = mp_phi->GetBufferPointer();
+
+  CSFLSCurvatureKernel block;
+  long i0 = 0;
+
+  double maxAbsDataTerm = -1e10;
+
+  long i = 0;
+  for (CSFLSLayer::const_iterator it = lz.begin(); it != lz.end(); ++it, ++i)
+    {
+      long ix = (*it)[0];
+      long iy = (*it)[1];
+
+      block.push(phi, m_nx, m_ny, ix, iy);
+
+      if (block.full())
+        {
+          block.computeCurvature(kappa + i0);
+          i0 += block.size();
+          block.clear();
+        }
+
+      double a = dataTermAt(ix, iy);
+      dataTerm[i] = a;
+
+      maxAbsDataTerm = fabs(a)>maxAbsDataTerm?fabs(a):maxAbsDataTerm;
+    }
+
+  block.computeCurvature(kappa + i0);
+
+  return maxAbsDataTerm;
+}
+
+
+/* ============================================================
+   computeForceAndMaxAbs
+
+   One sweep over Lz for the force terms, and one over the flat
+   buffers to combine them into m_force and find max|force|. The
+   buffers only grow, so there is no allocation once Lz stops
+   growing.  */
+template< typename TPixel >
+double
+CSFLSSegmentor2D< TPixel >
+::computeForceAndMaxAbs()
+{
+  long n = m_lz.size();
+  m_dataTerm.resize(n);
+  m_kappa.resize(n);
+  m_force.resize(n);
+
+  if (0 == n)
+    {
+      return 0.0;
+    }
+
+  double fmax = computeForceTermsOnLayer(m_lz, &m_dataTerm[0], &m_kappa[0]);
+
+  double maxAbsForce = 0.0;
+
+  for (long i = 0; i < n; ++i)
+    {
+      double f = m_dataTerm[i]/(fmax + 1e-10) + m_curvatureWeight*m_kappa[i];
+      m_force[i] = f;
+
+      double v = fabs(f);
+      maxAbsForce = maxAbsForce>v?maxAbsForce:v;
+    }
+
+  return maxAbsForce;
+}
+
+
+/* ============================================================
+   computeForce    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::computeForce()
+{
+  computeForceAndMaxAbs();
+}
+
+
+/* ============================================================
+   doSegmentation    */
+template< typename TPixel >
+void
+CSFLSSegmentor2D< TPixel >
+::doSegmentation()
+{
+  /*============================================================
+   * From the initial mask, generate: 1. SFLS, 2. mp_label and
+   * 3. mp_phi.
+   */
+  if (!m_warmStarted)
+    {
+      initializeSFLS();
+    }
+  m_warmStarted = false;
+
+  beforeEvolution();
+
+  resetConvergence();
+
+  if (m_numThreads != 1)
+    {
+      distributeLayersToStrips();
+
+      for (unsigned int it = 0; it < m_numIter; ++it)
+        {
+          oneStepLevelSetEvolutionInStrips();
+
+          afterIteration();
+
+          if (updateConvergence())
+            {
+              break;
+            }
+        }
+
+      gatherLayersFromStrips();
+
+      return;
+    }
+
+  for (unsigned int it = 0; it < m_numIter; ++it)
+    {
+      int64 tStart = m_instrumentation ? cv::getTickCount() : 0;
+
+      /// Same normalization as normalizeForce, applied by the evolution
+      double fMax = computeForceAndMaxAbs()/0.49;
+
+      int64 tForce = m_instrumentation ? cv::getTickCount() : 0;
+
+      oneStepLevelSetEvolution(fMax + 1e-10);
+
+      afterIteration();
+
+      if (m_instrumentation)
+        {
+          recordIterationStats(tStart, tForce, cv::getTickCount());
+        }
+
+      if (updateConvergence())
+        {
+          break;
+        }
+    }
+}
+
+
 //   /* ============================================================
 //      labelsCoherentCheck    */
 //   template< typename TPixel >
@@ -0,0 +1,125 @@
+#ifndef utilityImageView_h_
+#define utilityImageView_h_
+
+// std
+#include <cstdlib>
+#include <iostream>
+
+// itk
+#include "itkImportImageContainer.h"
+
+// local
+#include "itkTypedefs.h"
+
+
+namespace ImagenomicAnalytics
+{
+  namespace ImageView
+  {
+    /**
+     * Views between itk::Image and cv::Mat sharing the pixel buffer,
+     * where itk::OpenCVImageBridge copies it. Writing to a view writes
+     * to the image it is made from.
+     *
+     * Scalar pixels only, of a type cv::DataType knows. A 3 channel
+     * cv::Mat is BGR, and can not be seen as an itk::RGBPixel image.
+     */
+
+    /// Pixel container of an itk::Image view of a cv::Mat. It holds a
+    /// header of the cv::Mat, so the pixels stay allocated as long as
+    /// the view, even if the cv::Mat is released or reassigned first.
+    template< typename TElement >
+    class CVMatImportContainer : public itk::ImportImageContainer< itk::SizeValueType, TElement >
+    {
+    public:
+      typedef CVMatImportContainer Self;
+      typedef itk::ImportImageContainer< itk::SizeValueType, TElement > Superclass;
+      typedef itk::SmartPointer< Self > Pointer;
+      typedef itk::SmartPointer< const Self > ConstPointer;
+
+      itkNewMacro(Self);
+      itkTypeMacro(CVMatImportContainer, ImportImageContainer);
+
+      void SetMat(cv::Mat& image)
+      {
+        m_mat = image;
+
+        /// LetContainerManageMemory false: m_mat frees the buffer
+        this->SetImportPointer(m_mat.ptr<TElement>(), m_mat.total(), false);
+      }
+
+    protected:
+      CVMatImportContainer() {}
+      ~CVMatImportContainer() {}
+
+    private:
+      CVMatImportContainer(const Self&); // purposely not implemented
+      void operator=(const Self&); // purposely not implemented
+
+      cv::Mat m_mat;
+    };
+
+
+    /// itk::Image of the pixels of a continuous 2D cv::Mat, with
+    /// origin 0 and spacing 1 as given by the bridge
+    template< typename ImageType >
+    typename ImageType::Pointer cvMatAsItkImage(cv::Mat& image)
+    {
+      typedef typename ImageType::PixelType PixelType;
+
+      if (image.dims != 2 || !image.isContinuous() || image.type() != cv::DataType<PixelType>::type)
+        {
+          std::cerr<<"Error: the cv::Mat should be a continuous 2D image of the pixel type of the itk::Image.\n";
+          abort();
+        }
+
+      typename ImageType::RegionType region;
+      typename ImageType::IndexType start = {{0, 0}};
+      typename ImageType::SizeType size = {{static_cast<typename ImageType::SizeValueType>(image.cols),
+                                            static_cast<typename ImageType::SizeValueType>(image.rows)}};
+      region.SetIndex(start);
+      region.SetSize(size);
+
+      typename CVMatImportContainer< PixelType >::Pointer container = CVMatImportContainer< PixelType >::New();
+      container->SetMat(image);
+
+      typename ImageType::Pointer view = ImageType::New();
+      view->SetRegions(region);
+      view->SetPixelContainer(container);
+
+      return view;
+    }
+
+
+    /// cv::Mat header on the buffer of an itk::Image. The cv::Mat does
+    /// not hold the image: the image must outlive it, or it must be
+    /// cloned.
+    template< typename ImageType >
+    cv::Mat itkImageAsCVMat(ImageType* image)
+    {
+      typedef typename ImageType::PixelType PixelType;
+
+      if (!image || !image->GetBufferPointer())
+        {
+          std::cerr<<"Error: the itk::Image should be allocated.\n";
+          abort();
+        }
+
+      /// The buffer is continuous, and only the buffered region is in it
+      if (image->GetBufferedRegion() != image->GetLargestPossibleRegion())
+        {
+          std::cerr<<"Error: the itk::Image should be buffered whole.\n";
+          abort();
+        }
+
+      typename ImageType::SizeType size = image->GetBufferedRegion().GetSize();
+
+      return cv::Mat(static_cast<int>(size[1]), static_cast<int>(size[0]), cv::DataType<PixelType>::type,
+                     image->GetBufferPointer());
+    }
+
+  }// namespace ImageView
+
+}// namespace ImagenomicAnalytics
+
+#endif // utilityImageView_h_
@@ -1,3 +1,8 @@
+// std
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 // itk
 #include "itkOpenCVImageBridge.h"
 #include "itkTypedefs.h"
@@ -23,30 +28,29 @@
 
 #include "Normalization.h"
 #include "HistologicalEntities.h"
+#include "ConnComponents.h"
 #include "BinaryMaskAnalysisFilter.h"
+#include "NucleusFeatureEngine.h"
 #include "SFLSLocalChanVeseSegmentor2D.h"
+#include "SFLSChanVeseSegmentor2D.h"
 
 #include "itkTypedefs.h"
 
 #include "utilityScalarImage.h"
+#include "utilityImageView.h"
 #include "utilityIO.h"
+#include "utilityTileAnalysis.h"
 
 // #include "time.h"
 
 namespace ImagenomicAnalytics {
     namespace TileAnalysis {
         //--------------------------------------------------------------------------------
-        // Extract hematoxylin channel
-        template<typename TNull>
-        itkUCharImageType::Pointer ExtractHematoxylinChannel(itkRGBImageType::Pointer HAndEImage) {
-            int width = HAndEImage->GetLargestPossibleRegion().GetSize()[0];
-            int height = HAndEImage->GetLargestPossibleRegion().GetSize()[1];
-
-            std::string stainType = "H&E";
-
-            double leng, A, V, C, log255 = log(255.0);
-            int i, j;
-            int channelIndex = 0; ///< 0: Hematoxylin; 1: Eosin
+        // Inverse of the H&E stain matrix of the color deconvolution. Row
+        // 0: Hematoxylin; 1: Eosin; 2: the complementary color
+        void computeStainInverse(double q[9]) {
+            double leng, A, V, C;
+            int i;
             double MODx[3];
             double MODy[3];
             double MODz[3];
@@ -54,10 +58,6 @@ namespace ImagenomicAnalytics {
             double cosy[3];
             double cosz[3];
             double len[3];
-            double q[9];
-            // unsigned char rLUT[256];
-            // unsigned char gLUT[256];
-            // unsigned char bLUT[256];
 
             //if (!stainType.compare("H&E"))
             {
@@ -150,85 +150,256 @@ namespace ImagenomicAnalytics {
             q[8] = 1.0 / C;
             q[7] = -q[8] * V / A;
             q[6] = -q[7] * cosy[0] / cosx[0] - q[8] * cosz[0] / cosx[0];
+        }
+        //================================================================================
 
-            // initialize 3 output colour stacks
-            itkUCharImageType::Pointer hematoxylinChannel = itkUCharImageType::New();
-            hematoxylinChannel->SetRegions(HAndEImage->GetLargestPossibleRegion());
-            hematoxylinChannel->Allocate();
-            hematoxylinChannel->CopyInformation(HAndEImage);
 
-            itkUCharImageType::PixelType *newpixels = hematoxylinChannel->GetBufferPointer();
+        //--------------------------------------------------------------------------------
+        // Lookup tables of the color deconvolution of one stain. A pixel
+        // only depends on its three 8-bit channels, and its output is the
+        // rounded exp of the sum of one term per channel: the terms are
+        // tabulated, and the exp is replaced by the sums at which the
+        // rounded output steps down.
+        struct StainLUT {
+            double od[3][256]; ///< R, G, B optical density times the stain inverse
+            double threshold[256]; ///< output >= k iff the sum of the od is <= threshold[k]. Decreasing
+        };
+
+        // Output of the original per pixel formula, for a sum of the od
+        unsigned char stainOutput(double odSum) {
+            double log255 = log(255.0);
+            double output = exp(-(odSum - 255.0) * log255 / 255.0);
+
+            if (output > 255) {
+                output = 255;
+            }
 
-            // for (j=0; j<256; j++)
-            //   {
-            //     rLUT[255-j]=static_cast<unsigned char>(255.0 - (double)j * cosx[channelIndex]);
-            //     gLUT[255-j]=static_cast<unsigned char>(255.0 - (double)j * cosy[channelIndex]);
-            //     bLUT[255-j]=static_cast<unsigned char>(255.0 - (double)j * cosz[channelIndex]);
-            //   }
+            return static_cast<unsigned char>(0xff & static_cast<int>(floor(output + .5)));
+        }
 
-            // translate ------------------
-            int imagesize = width * height;
+        StainLUT computeStainLUT(int channelIndex) {
+            double q[9];
+            computeStainInverse(q);
 
-            itkRGBImageType::PixelType *rgbImagePointer = HAndEImage->GetBufferPointer();
+            StainLUT lut;
 
-            for (j = 0; j < imagesize; j++) {
+            double log255 = log(255.0);
+            for (int v = 0; v < 256; v++) {
                 // log transform the RGB data
-                unsigned char R = rgbImagePointer[j].GetRed();
-                unsigned char G = rgbImagePointer[j].GetGreen();
-                unsigned char B = rgbImagePointer[j].GetBlue();
-                double Rlog = -((255.0 * log((static_cast<double>(R) + 1) / 255.0)) / log255);
-                double Glog = -((255.0 * log((static_cast<double>(G) + 1) / 255.0)) / log255);
-                double Blog = -((255.0 * log((static_cast<double>(B) + 1) / 255.0)) / log255);
+                double odLog = -((255.0 * log((static_cast<double>(v) + 1) / 255.0)) / log255);
 
                 // rescale to match original paper values
-                double Rscaled = Rlog * q[channelIndex * 3];
-                double Gscaled = Glog * q[channelIndex * 3 + 1];
-                double Bscaled = Blog * q[channelIndex * 3 + 2];
-                double output = exp(-((Rscaled + Gscaled + Bscaled) - 255.0) * log255 / 255.0);
+                for (int c = 0; c < 3; c++) {
+                    lut.od[c][v] = odLog * q[channelIndex * 3 + c];
+                }
+            }
+
+            // Solve output = k - 0.5 for the sum, then bisect to the largest
+            // double for which the formula still gives k, so that the result
+            // is exactly that of the formula
+            lut.threshold[0] = std::numeric_limits<double>::max();
+            for (int k = 1; k < 256; k++) {
+                double t = 255.0 - 255.0 * log(k - 0.5) / log255;
+                double lo = t - 1e-6;
+                double hi = t + 1e-6;
+
+                while (true) {
+                    double mid = lo + (hi - lo) / 2;
+                    if (mid <= lo || mid >= hi) {
+                        break;
+                    }
 
-                if (output > 255) {
-                    output = 255;
+                    if (stainOutput(mid) >= k) {
+                        lo = mid;
+                    } else {
+                        hi = mid;
+                    }
                 }
 
-                unsigned char idx = static_cast<unsigned char>(0xff & static_cast<int>(floor(output + .5)));
+                lut.threshold[k] = lo;
+            }
+
+            return lut;
+        }
 
-                ////////////////////////////////////////////////////////////////////////////////
-                /// Index to rgb to gray
-                ///
-                /// The original ImageJ plugin output the colorful H
-                /// channel as a indexed image using a LUT. Here I first
-                /// use the LUT to convert the index to rgb and then
-                /// convert to gray. The formula below is what we have
-                /// in matlab rgb2gray
-                //newpixels[j] = static_cast<itkUCharImageType::PixelType>(0.2989*rLUT[idx] + 0.5870*gLUT[idx] + 0.1140*bLUT[idx]);
-                newpixels[j] = idx;
-                /// Index to rgb to gray, end
-                ////////////////////////////////////////////////////////////////////////////////
+        // Tables of the three stains. The stain matrix is fixed: they are
+        // computed once, at static initialization, so that they are ready
+        // before any parallel region reads them.
+        const StainLUT stainLUTs[3] = {computeStainLUT(0), computeStainLUT(1), computeStainLUT(2)};
+
+        // Tables of a stain. channelIndex 0: Hematoxylin; 1: Eosin; 2: the
+        // third, complementary, color.
+        const StainLUT &stainLUT(int channelIndex) {
+            if (channelIndex < 0 || channelIndex > 2) {
+                std::cerr << "Error: channelIndex should be 0, 1 or 2.\n";
+                abort();
             }
 
+            return stainLUTs[channelIndex];
+        }
+
+        // Stain channel of a range of rows of an 8-bit 3 channel image, RGB
+        // or BGR as given by the channel offsets
+        class StainChannelBody : public cv::ParallelLoopBody {
+        public:
+            StainChannelBody(const unsigned char *pixels, std::size_t rowStep, long width, int redOffset,
+                             int blueOffset, itkUCharImageType::PixelType *stain, const StainLUT &lut)
+                    : m_pixels(pixels), m_rowStep(rowStep), m_width(width), m_redOffset(redOffset),
+                      m_blueOffset(blueOffset), m_stain(stain), m_lut(lut) {}
+
+            virtual void operator()(const cv::Range &range) const {
+                const double *odR = m_lut.od[0];
+                const double *odG = m_lut.od[1];
+                const double *odB = m_lut.od[2];
+                const double *threshold = m_lut.threshold;
+
+                for (int i = range.start; i < range.end; i++) {
+                    const unsigned char *row = m_pixels + i * m_rowStep;
+                    itkUCharImageType::PixelType *stainRow = m_stain + i * m_width;
+
+                    for (long j = 0; j < m_width; j++) {
+                        const unsigned char *pixel = row + j * 3;
+                        double odSum = odR[pixel[m_redOffset]] + odG[pixel[1]] + odB[pixel[m_blueOffset]];
+
+                        // largest k with odSum <= threshold[k], branch free
+                        int k = 0;
+                        for (int step = 128; step > 0; step >>= 1) {
+                            k += odSum <= threshold[k + step] ? step : 0;
+                        }
+
+                        ////////////////////////////////////////////////////////////////////////////////
+                        /// Index to rgb to gray
+                        ///
+                        /// The original ImageJ plugin output the colorful H
+                        /// channel as a indexed image using a LUT. Here the
+                        /// index is the gray value, as matlab rgb2gray of the
+                        /// LUT color would give.
+                        stainRow[j] = static_cast<itkUCharImageType::PixelType>(k);
+                        /// Index to rgb to gray, end
+                        ////////////////////////////////////////////////////////////////////////////////
+                    }
+                }
+            }
 
-            return hematoxylinChannel;
+        private:
+            const unsigned char *m_pixels;
+            std::size_t m_rowStep;
+            long m_width;
+            int m_redOffset;
+            int m_blueOffset;
+            itkUCharImageType::PixelType *m_stain;
+            const StainLUT &m_lut;
+        };
+        //================================================================================
+
+
+        //--------------------------------------------------------------------------------
+        // Extract a stain channel by color deconvolution. channelIndex 0:
+        // Hematoxylin; 1: Eosin; 2: the third, complementary, color.
+        // numberOfThreads 1: serial, otherwise rows in parallel.
+        template<typename TNull>
+        itkUCharImageType::Pointer ExtractStainChannel(itkRGBImageType::Pointer HAndEImage, int channelIndex,
+                                                       int numberOfThreads = 1) {
+            const StainLUT &lut = stainLUT(channelIndex);
+
+            int width = HAndEImage->GetLargestPossibleRegion().GetSize()[0];
+            int height = HAndEImage->GetLargestPossibleRegion().GetSize()[1];
+
+            itkUCharImageType::Pointer stainChannel = itkUCharImageType::New();
+            stainChannel->SetRegions(HAndEImage->GetLargestPossibleRegion());
+            stainChannel->Allocate();
+            stainChannel->CopyInformation(HAndEImage);
+
+            // itk::RGBPixel<unsigned char> is 3 bytes, R, G, B
+            StainChannelBody stainChannelBody(reinterpret_cast<const unsigned char *>(HAndEImage->GetBufferPointer()),
+                                              3 * width, width, 0, 2, stainChannel->GetBufferPointer(), lut);
+            if (1 == numberOfThreads) {
+                stainChannelBody(cv::Range(0, height));
+            } else {
+                cv::parallel_for_(cv::Range(0, height), stainChannelBody);
+            }
+
+            return stainChannel;
+        }
+
+        // Same, from the BGR image as read by OpenCV, without converting it
+        // to an itk RGB image first
+        template<typename TNull>
+        itkUCharImageType::Pointer ExtractStainChannel(const cv::Mat &HAndEImage, int channelIndex,
+                                                       int numberOfThreads = 1) {
+            if (HAndEImage.type() != CV_8UC3) {
+                std::cerr << "Error: the H&E image should be CV_8UC3.\n";
+                abort();
+            }
+
+            const StainLUT &lut = stainLUT(channelIndex);
+
+            itkUCharImageType::RegionType region;
+            itkUCharImageType::IndexType start = {{0, 0}};
+            itkUCharImageType::SizeType size = {{static_cast<itkUCharImageType::SizeValueType>(HAndEImage.cols),
+                                                 static_cast<itkUCharImageType::SizeValueType>(HAndEImage.rows)}};
+            region.SetIndex(start);
+            region.SetSize(size);
+
+            itkUCharImageType::Pointer stainChannel = itkUCharImageType::New();
+            stainChannel->SetRegions(region);
+            stainChannel->Allocate();
+
+            StainChannelBody stainChannelBody(HAndEImage.ptr<unsigned char>(), HAndEImage.step, HAndEImage.cols, 2, 0,
+                                              stainChannel->GetBufferPointer(), lut);
+            if (1 == numberOfThreads) {
+                stainChannelBody(cv::Range(0, HAndEImage.rows));
+            } else {
+                cv::parallel_for_(cv::Range(0, HAndEImage.rows), stainChannelBody);
+            }
+
+            return stainChannel;
+        }
+        //================================================================================
+
+
+        //--------------------------------------------------------------------------------
+        // Extract hematoxylin channel
+        template<typename TNull>
+        itkUCharImageType::Pointer ExtractHematoxylinChannel(itkRGBImageType::Pointer HAndEImage, int numberOfThreads = 1) {
+            return ExtractStainChannel<TNull>(HAndEImage, 0, numberOfThreads);
+        }
+
+        template<typename TNull>
+        itkUCharImageType::Pointer ExtractHematoxylinChannel(const cv::Mat &HAndEImage, int numberOfThreads = 1) {
+            return ExtractStainChannel<TNull>(HAndEImage, 0, numberOfThreads);
         }
         //================================================================================
 
 
         template<typename TNull>
-        cv::Mat normalizeImageColor(cv::Mat image) {
+        cv::Mat normalizeImageColor(cv::Mat image, bool fused = false, int numberOfThreads = 1) {
             float meanT[3] = {-0.632356, -0.0516004, 0.0376543};
             float stdT[3] = {0.26235, 0.0514831,
                              0.0114217}; ///< These are learnt from the template GBM image selected by George
-            cv::Mat newImgCV = nscale::Normalization::normalization(image, meanT, stdT);
+            cv::Mat newImgCV;
+            if (fused) {
+                newImgCV = nscale::Normalization::fusedNormalization(image, meanT, stdT, numberOfThreads);
+            } else {
+                newImgCV = nscale::Normalization::normalization(image, meanT, stdT);
+            }
 
             return newImgCV;
         }
 
 
         template<typename TNull>
-        itkUCharImageType::Pointer extractTissueMask(cv::Mat image) {
+        cv::Mat extractTissueMaskCV(cv::Mat image) {
             float mData[8] = {-0.154, 0.035, 0.549, -45.718, -0.057, -0.817, 1.170, -49.887};
             cv::Mat M = cv::Mat(2, 4, CV_32FC1, &mData);
 
-            cv::Mat maskCV = nscale::Normalization::segFG(image, M);
+            return nscale::Normalization::segFG(image, M);
+        }
+
+
+        template<typename TNull>
+        itkUCharImageType::Pointer extractTissueMask(cv::Mat image) {
+            cv::Mat maskCV = extractTissueMaskCV<TNull>(image);
             itkUCharImageType::Pointer foregroundMask = itk::OpenCVImageBridge::CVMatToITKImage<itkUCharImageType>(
                     maskCV);
 
@@ -371,6 +542,388 @@ namespace ImagenomicAnalytics {
             return mask;
         }
 
+        //--------------------------------------------------------------------------------
+        // The Chan-Vese segmentor LevelSetOptions::globalChanVese asks for
+        typedef CSFLSSegmentor2D<itkFloatImageType::PixelType> ChanVeseSegmentorType;
+        typedef CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType> LocalChanVeseSegmentorType;
+        typedef CSFLSChanVeseSegmentor2D<itkFloatImageType::PixelType> GlobalChanVeseSegmentorType;
+
+        ChanVeseSegmentorType &chanVeseSegmentor(const LevelSetOptions &levelSetOptions,
+                                                 LocalChanVeseSegmentorType &localSegmentor,
+                                                 GlobalChanVeseSegmentorType &globalSegmentor) {
+            if (levelSetOptions.globalChanVese) {
+                return globalSegmentor;
+            }
+
+            return localSegmentor;
+        }
+
+        //--------------------------------------------------------------------------------
+        // Chan-Vese on each object of a mask, in its own padded bounding box
+        //
+        // The local Chan-Vese force only looks at a small neighborhood of
+        // the front, so an isolated object can be evolved in a small
+        // sub-image. The objects are independent, and are evolved in
+        // parallel on OpenCV's thread pool.
+        struct ObjectSubDomain {
+            unsigned int label;
+            long xBegin, yBegin, xEnd, yEnd; ///< padded bounding box, end excluded
+            std::vector<unsigned char> result;
+            long numberOfIterations;
+            std::vector<CSFLSIterationStats> iterationStats; ///< with LevelSetOptions::instrumentation
+        };
+
+        class ChanVesePerObjectBody : public cv::ParallelLoopBody {
+        public:
+            ChanVesePerObjectBody(itkFloatImageType::Pointer image, itkUIntImageType::Pointer labelImage,
+                                  std::vector<ObjectSubDomain> &objects, int numberOfIterations,
+                                  double curvatureWeight, double meanIn, double meanOut,
+                                  const LevelSetOptions &levelSetOptions)
+                    : m_image(image), m_labelImage(labelImage), m_objects(objects),
+                      m_numberOfIterations(numberOfIterations), m_curvatureWeight(curvatureWeight),
+                      m_meanIn(meanIn), m_meanOut(meanOut), m_levelSetOptions(levelSetOptions) {}
+
+            virtual void operator()(const cv::Range &range) const {
+                long tileNx = m_image->GetLargestPossibleRegion().GetSize()[0];
+                const itkFloatImageType::PixelType *imageBufferPointer = m_image->GetBufferPointer();
+                const itkUIntImageType::PixelType *labelBufferPointer = m_labelImage->GetBufferPointer();
+
+                for (int io = range.start; io < range.end; ++io) {
+                    ObjectSubDomain &object = m_objects[io];
+                    long nx = object.xEnd - object.xBegin;
+                    long ny = object.yEnd - object.yBegin;
+
+                    itkFloatImageType::RegionType region;
+                    itkFloatImageType::IndexType start = {{0, 0}};
+                    itkFloatImageType::SizeType size = {{static_cast<itkFloatImageType::SizeValueType>(nx),
+                                                         static_cast<itkFloatImageType::SizeValueType>(ny)}};
+                    region.SetIndex(start);
+                    region.SetSize(size);
+
+                    itkFloatImageType::Pointer subImage = itkFloatImageType::New();
+                    subImage->SetRegions(region);
+                    subImage->Allocate();
+
+                    itkUCharImageType::Pointer subMask = itkUCharImageType::New();
+                    subMask->SetRegions(region);
+                    subMask->Allocate();
+
+                    itkFloatImageType::PixelType *subImageBufferPointer = subImage->GetBufferPointer();
+                    itkUCharImageType::PixelType *subMaskBufferPointer = subMask->GetBufferPointer();
+
+                    for (long iy = 0; iy < ny; ++iy) {
+                        long offset = (object.yBegin + iy) * tileNx + object.xBegin;
+                        for (long ix = 0; ix < nx; ++ix) {
+                            subImageBufferPointer[iy * nx + ix] = imageBufferPointer[offset + ix];
+                            subMaskBufferPointer[iy * nx + ix] = labelBufferPointer[offset + ix] == object.label ? 1 : 0;
+                        }
+                    }
+
+                    // the objects are already in parallel: one thread each
+                    LocalChanVeseSegmentorType localSegmentor;
+                    GlobalChanVeseSegmentorType globalSegmentor;
+                    // a box's own means would be local ones: use the tile's
+                    globalSegmentor.setFixedMeans(m_meanIn, m_meanOut);
+                    ChanVeseSegmentorType &segmentor = chanVeseSegmentor(m_levelSetOptions, localSegmentor, globalSegmentor);
+                    segmentor.setImage(subImage);
+                    segmentor.setMask(subMask);
+                    segmentor.setNumIter(m_numberOfIterations);
+                    segmentor.setCurvatureWeight(m_curvatureWeight);
+                    segmentor.setConvergenceTolerance(m_levelSetOptions.convergenceTolerance);
+                    segmentor.setInstrumentation(m_levelSetOptions.instrumentation);
+                    segmentor.doSegmentation();
+
+                    object.numberOfIterations = segmentor.getNumIterDone();
+                    object.iterationStats = segmentor.getIterationStats();
+
+                    const ChanVeseSegmentorType::LSImageType::PixelType *phiBufferPointer = segmentor.mp_phi->GetBufferPointer();
+
+                    object.result.resize(nx * ny);
+                    for (long it = 0; it < nx * ny; ++it) {
+                        object.result[it] = phiBufferPointer[it] <= 1.0 ? 1 : 0;
+                    }
+                }
+            }
+
+        private:
+            itkFloatImageType::Pointer m_image;
+            itkUIntImageType::Pointer m_labelImage;
+            std::vector<ObjectSubDomain> &m_objects;
+            int m_numberOfIterations;
+            double m_curvatureWeight;
+            double m_meanIn, m_meanOut; ///< of the whole tile, for globalChanVese
+            const LevelSetOptions &m_levelSetOptions;
+        };
+
+        /**
+         * Replace the mask by the union of the per-object Chan-Vese
+         * results. Return the largest number of iterations run by an
+         * object.
+         *
+         * Follows globalChanVese, convergenceTolerance and
+         * instrumentation. With globalChanVese, every object uses the
+         * inside/outside means of the whole tile under the input mask,
+         * fixed for the pass: the objects do not see each other move.
+         * With instrumentation, iterationStats gets the stats of the
+         * objects summed iteration by iteration (the seconds are summed
+         * over the threads). Objects run in parallel unless
+         * numberOfThreads is 1. There is no warm start: the first pass
+         * phi is of the whole tile.
+         */
+        template<typename TNull>
+        long chanVesePerObject(itkFloatImageType::Pointer hemaFloat, \
+                               itkUCharImageType::Pointer nucleusBinaryMask, \
+                               int numberOfIterations, \
+                               double curvatureWeight, \
+                               const LevelSetOptions &levelSetOptions, \
+                               std::vector<CSFLSIterationStats> *iterationStats = NULL) {
+            typedef itk::ConnectedComponentImageFilter<itkUCharImageType, itkUIntImageType> ConnectedComponentImageFilterType;
+            ConnectedComponentImageFilterType::Pointer connected = ConnectedComponentImageFilterType::New();
+            connected->SetInput(nucleusBinaryMask);
+            connected->Update();
+
+            itkUIntImageType::Pointer labelImage = connected->GetOutput();
+            unsigned int numberOfObjects = connected->GetObjectCount();
+
+            long nx = nucleusBinaryMask->GetLargestPossibleRegion().GetSize()[0];
+            long ny = nucleusBinaryMask->GetLargestPossibleRegion().GetSize()[1];
+            long padding = levelSetOptions.secondPassPadding;
+
+            // bounding boxes, in one scan of the label image
+            std::vector<ObjectSubDomain> objects(numberOfObjects);
+            for (unsigned int io = 0; io < numberOfObjects; ++io) {
+                objects[io].label = io + 1;
+                objects[io].xBegin = nx;
+                objects[io].yBegin = ny;
+                objects[io].xEnd = 0;
+                objects[io].yEnd = 0;
+                objects[io].numberOfIterations = 0;
+            }
+
+            const itkUIntImageType::PixelType *labelBufferPointer = labelImage->GetBufferPointer();
+            for (long iy = 0; iy < ny; ++iy) {
+                for (long ix = 0; ix < nx; ++ix) {
+                    itkUIntImageType::PixelType label = labelBufferPointer[iy * nx + ix];
+                    if (label == 0) {
+                        continue;
+                    }
+
+                    ObjectSubDomain &object = objects[label - 1];
+                    object.xBegin = std::min(object.xBegin, ix);
+                    object.yBegin = std::min(object.yBegin, iy);
+                    object.xEnd = std::max(object.xEnd, ix + 1);
+                    object.yEnd = std::max(object.yEnd, iy + 1);
+                }
+            }
+
+            for (unsigned int io = 0; io < numberOfObjects; ++io) {
+                objects[io].xBegin = std::max(objects[io].xBegin - padding, 0L);
+                objects[io].yBegin = std::max(objects[io].yBegin - padding, 0L);
+                objects[io].xEnd = std::min(objects[io].xEnd + padding, nx);
+                objects[io].yEnd = std::min(objects[io].yEnd + padding, ny);
+            }
+
+            // tile-wide means, for globalChanVese
+            double sumIn = 0, sumOut = 0, areaIn = 0, areaOut = 0;
+            if (levelSetOptions.globalChanVese) {
+                const itkFloatImageType::PixelType *hemaFloatBufferPointer = hemaFloat->GetBufferPointer();
+                const itkUCharImageType::PixelType *maskBufferPointer = nucleusBinaryMask->GetBufferPointer();
+                for (long it = 0; it < nx * ny; ++it) {
+                    if (maskBufferPointer[it] != 0) {
+                        sumIn += hemaFloatBufferPointer[it];
+                        ++areaIn;
+                    } else {
+                        sumOut += hemaFloatBufferPointer[it];
+                        ++areaOut;
+                    }
+                }
+            }
+
+            ChanVesePerObjectBody chanVesePerObjectBody(hemaFloat, labelImage, objects, numberOfIterations,
+                                                        curvatureWeight, sumIn / (areaIn + vnl_math::eps),
+                                                        sumOut / (areaOut + vnl_math::eps), levelSetOptions);
+            if (1 == levelSetOptions.numberOfThreads) {
+                chanVesePerObjectBody(cv::Range(0, numberOfObjects));
+            } else {
+                cv::parallel_for_(cv::Range(0, numberOfObjects), chanVesePerObjectBody);
+            }
+
+            // paste back. The padded boxes may overlap: take the union.
+            itkUCharImageType::PixelType *nucleusBinaryMaskBufferPointer = nucleusBinaryMask->GetBufferPointer();
+            std::fill(nucleusBinaryMaskBufferPointer, nucleusBinaryMaskBufferPointer + nx * ny, 0);
+
+            long maxNumberOfIterations = 0;
+            for (unsigned int io = 0; io < numberOfObjects; ++io) {
+                const ObjectSubDomain &object = objects[io];
+                long objectNx = object.xEnd - object.xBegin;
+
+                for (long iy = object.yBegin; iy < object.yEnd; ++iy) {
+                    const unsigned char *resultRow = &object.result[(iy - object.yBegin) * objectNx];
+                    itkUCharImageType::PixelType *maskRow = nucleusBinaryMaskBufferPointer + iy * nx + object.xBegin;
+                    for (long ix = 0; ix < objectNx; ++ix) {
+                        maskRow[ix] |= resultRow[ix];
+                    }
+                }
+
+                maxNumberOfIterations = std::max(maxNumberOfIterations, object.numberOfIterations);
+            }
+
+            if (iterationStats) {
+                iterationStats->clear();
+                for (unsigned int io = 0; io < numberOfObjects; ++io) {
+                    const std::vector<CSFLSIterationStats> &objectStats = objects[io].iterationStats;
+                    for (std::size_t it = 0; it < objectStats.size(); ++it) {
+                        if (it == iterationStats->size()) {
+                            iterationStats->push_back(CSFLSIterationStats());
+                        }
+
+                        CSFLSIterationStats &sum = (*iterationStats)[it];
+                        sum.m_lz += objectStats[it].m_lz;
+                        sum.m_ln1 += objectStats[it].m_ln1;
+                        sum.m_ln2 += objectStats[it].m_ln2;
+                        sum.m_lp1 += objectStats[it].m_lp1;
+                        sum.m_lp2 += objectStats[it].m_lp2;
+                        sum.m_in2out += objectStats[it].m_in2out;
+                        sum.m_out2in += objectStats[it].m_out2in;
+                        sum.m_forceSeconds += objectStats[it].m_forceSeconds;
+                        sum.m_evolutionSeconds += objectStats[it].m_evolutionSeconds;
+                    }
+                }
+            }
+
+            return maxNumberOfIterations;
+        }
+        //================================================================================
+
+
+        //--------------------------------------------------------------------------------
+        // Coarse level of the multi-resolution Chan-Vese
+        //
+        // Evolve the level set on the image and mask downsampled by
+        // 2^pyramidLevels, then return the full resolution mask of the
+        // bilinearly upsampled phi. The caller refines it with a short
+        // full resolution evolution. Follows globalChanVese.
+        //
+        // Null if the coarse mask, or the mask from the coarse phi, is
+        // empty (objects smaller than the coarse pixels): the caller then
+        // runs the full resolution evolution from its own mask.
+        template<typename TNull>
+        itkUCharImageType::Pointer coarseChanVeseMask(itkFloatImageType::Pointer hemaFloat, \
+                                                      itkUCharImageType::Pointer nucleusBinaryMask, \
+                                                      int numberOfIterations, \
+                                                      double curvatureWeight, \
+                                                      const LevelSetOptions &levelSetOptions, \
+                                                      LevelSetReport *levelSetReport) {
+            long f = 1L << levelSetOptions.pyramidLevels;
+
+            long nx = hemaFloat->GetLargestPossibleRegion().GetSize()[0];
+            long ny = hemaFloat->GetLargestPossibleRegion().GetSize()[1];
+            long cnx = (nx + f - 1) / f;
+            long cny = (ny + f - 1) / f;
+
+            itkFloatImageType::RegionType coarseRegion;
+            itkFloatImageType::IndexType start = {{0, 0}};
+            itkFloatImageType::SizeType coarseSize = {{static_cast<itkFloatImageType::SizeValueType>(cnx),
+                                                       static_cast<itkFloatImageType::SizeValueType>(cny)}};
+            coarseRegion.SetIndex(start);
+            coarseRegion.SetSize(coarseSize);
+
+            itkFloatImageType::Pointer coarseImage = itkFloatImageType::New();
+            coarseImage->SetRegions(coarseRegion);
+            coarseImage->Allocate();
+            coarseImage->FillBuffer(0);
+
+            itkUCharImageType::Pointer coarseMask = itkUCharImageType::New();
+            coarseMask->SetRegions(coarseRegion);
+            coarseMask->Allocate();
+
+            // box average, mask by majority
+            std::vector<long> maskCount(cnx * cny, 0);
+            std::vector<long> pixelCount(cnx * cny, 0);
+
+            const itkFloatImageType::PixelType *hemaBufferPointer = hemaFloat->GetBufferPointer();
+            const itkUCharImageType::PixelType *maskBufferPointer = nucleusBinaryMask->GetBufferPointer();
+            itkFloatImageType::PixelType *coarseImageBufferPointer = coarseImage->GetBufferPointer();
+            itkUCharImageType::PixelType *coarseMaskBufferPointer = coarseMask->GetBufferPointer();
+
+            for (long iy = 0; iy < ny; ++iy) {
+                for (long ix = 0; ix < nx; ++ix) {
+                    long ic = (iy / f) * cnx + ix / f;
+                    coarseImageBufferPointer[ic] += hemaBufferPointer[iy * nx + ix];
+                    maskCount[ic] += maskBufferPointer[iy * nx + ix] != 0 ? 1 : 0;
+                    ++pixelCount[ic];
+                }
+            }
+
+            for (long ic = 0; ic < cnx * cny; ++ic) {
+                coarseImageBufferPointer[ic] /= pixelCount[ic];
+                coarseMaskBufferPointer[ic] = 2 * maskCount[ic] >= pixelCount[ic] ? 1 : 0;
+            }
+
+            if (ScalarImage::isImageAllZero<itkBinaryMaskImageType>(coarseMask)) {
+                return 0;
+            }
+
+            LocalChanVeseSegmentorType localSegmentor;
+            GlobalChanVeseSegmentorType globalSegmentor;
+            ChanVeseSegmentorType &segmentor = chanVeseSegmentor(levelSetOptions, localSegmentor, globalSegmentor);
+            segmentor.setImage(coarseImage);
+            segmentor.setMask(coarseMask);
+            segmentor.setNumIter(numberOfIterations);
+            segmentor.setCurvatureWeight(curvatureWeight);
+            if (!levelSetOptions.globalChanVese) {
+                // keep the local window about the same physical size, but not
+                // below 5x5: the local means get too noisy
+                long nbhd = std::max((localSegmentor.m_nbx + f / 2) / f, 2L);
+                localSegmentor.setNBHDSize(nbhd, nbhd);
+            }
+            segmentor.setNumThreads(levelSetOptions.numberOfThreads);
+            segmentor.setConvergenceTolerance(levelSetOptions.convergenceTolerance);
+            segmentor.doSegmentation();
+
+            if (levelSetReport) {
+                levelSetReport->numberOfIterationsCoarse = segmentor.getNumIterDone();
+            }
+
+            itkUCharImageType::Pointer refinementMask = itkUCharImageType::New();
+            refinementMask->SetRegions(nucleusBinaryMask->GetLargestPossibleRegion());
+            refinementMask->Allocate();
+            refinementMask->CopyInformation(nucleusBinaryMask);
+
+            // bilinear upsampling of phi, sampled at the fine pixel centers
+            const ChanVeseSegmentorType::LSImageType::PixelType *phiBufferPointer = segmentor.mp_phi->GetBufferPointer();
+            itkUCharImageType::PixelType *refinementMaskBufferPointer = refinementMask->GetBufferPointer();
+
+            for (long iy = 0; iy < ny; ++iy) {
+                double y = (iy + 0.5) / f - 0.5;
+                y = std::min(std::max(y, 0.0), static_cast<double>(cny - 1));
+                long y0 = std::min(static_cast<long>(y), cny - 2 >= 0 ? cny - 2 : 0);
+                long y1 = std::min(y0 + 1, cny - 1);
+                double wy = y - y0;
+
+                for (long ix = 0; ix < nx; ++ix) {
+                    double x = (ix + 0.5) / f - 0.5;
+                    x = std::min(std::max(x, 0.0), static_cast<double>(cnx - 1));
+                    long x0 = std::min(static_cast<long>(x), cnx - 2 >= 0 ? cnx - 2 : 0);
+                    long x1 = std::min(x0 + 1, cnx - 1);
+                    double wx = x - x0;
+
+                    double phi = (1 - wy) * ((1 - wx) * phiBufferPointer[y0 * cnx + x0] + wx * phiBufferPointer[y0 * cnx + x1])
+                                 + wy * ((1 - wx) * phiBufferPointer[y1 * cnx + x0] + wx * phiBufferPointer[y1 * cnx + x1]);
+
+                    refinementMaskBufferPointer[iy * nx + ix] = phi <= 0 ? 1 : 0;
+                }
+            }
+
+            if (ScalarImage::isImageAllZero<itkBinaryMaskImageType>(refinementMask)) {
+                return 0;
+            }
+
+            return refinementMask;
+        }
+        //================================================================================
+
+
         /**
          * Process Tile
          * declumpingType:
@@ -388,20 +941,40 @@ namespace ImagenomicAnalytics {
                                            double mpp = 0.25, \
                                            float msKernel = 20.0, \
                                            int levelsetNumberOfIteration = 100, \
-                                           int declumpingType = 0) {
+                                           int declumpingType = 0, \
+                                           const TileOptions &tileOptions = TileOptions(), \
+                                           const LevelSetOptions &levelSetOptions = LevelSetOptions(), \
+                                           LevelSetReport *levelSetReport = NULL) {
+            if (levelSetOptions.warmStartSecondPass && levelSetOptions.secondPassPerObject) {
+                std::cerr << "Error: warmStartSecondPass does not apply to secondPassPerObject.\n";
+                abort();
+            }
 
-            std::cout << "normalizeImageColor.....\n" << std::flush;
-            cv::Mat newImgCV = normalizeImageColor<char>(thisTileCV);
+            if (levelSetOptions.pyramidLevels < 0 || levelSetOptions.pyramidLevels > 2) {
+                std::cerr << "Error: pyramidLevels should be 0, 1 or 2. But got " << levelSetOptions.pyramidLevels << std::endl;
+                abort();
+            }
 
-            std::cout << "extractTissueMask.....\n" << std::flush;
-            itkUCharImageType::Pointer foregroundMask = extractTissueMask<char>(newImgCV);
+            if (levelSetOptions.pyramidRefinementIterations < 0) {
+                std::cerr << "Error: pyramidRefinementIterations should be >= 0. But got "
+                          << levelSetOptions.pyramidRefinementIterations << std::endl;
+                abort();
+            }
 
-            itkRGBImageType::Pointer thisTile = itk::OpenCVImageBridge::CVMatToITKImage<itkRGBImageType>(thisTileCV);
+            if (levelSetReport) {
+                *levelSetReport = LevelSetReport();
+            }
+
+            std::cout << "normalizeImageColor.....\n" << std::flush;
+            cv::Mat newImgCV = normalizeImageColor<char>(thisTileCV, tileOptions.fusedColorNormalization,
+                                                          tileOptions.numberOfThreads);
 
-            //IO::writeImage<itkRGBImageType>(thisTile, "thisTile.png", 0);
+            std::cout << "extractTissueMask.....\n" << std::flush;
+            cv::Mat foregroundMaskCV = extractTissueMaskCV<char>(newImgCV);
+            itkUCharImageType::Pointer foregroundMask = ImageView::cvMatAsItkImage<itkUCharImageType>(foregroundMaskCV);
 
             std::cout << "ExtractHematoxylinChannel.....\n" << std::flush;
-            itkUCharImageType::Pointer hematoxylinImage = ExtractHematoxylinChannel<char>(thisTile);
+            itkUCharImageType::Pointer hematoxylinImage = ExtractHematoxylinChannel<char>(thisTileCV, tileOptions.numberOfThreads);
 
             short maskValue = 1;
 
@@ -431,25 +1004,49 @@ namespace ImagenomicAnalytics {
             }
 
             // SEGMENT: ChanVese
+            // Kept alive to warm start the second pass
+            LocalChanVeseSegmentorType localFirstPassSegmentor;
+            GlobalChanVeseSegmentorType globalFirstPassSegmentor;
+            ChanVeseSegmentorType &firstPassSegmentor = chanVeseSegmentor(levelSetOptions, localFirstPassSegmentor,
+                                                                          globalFirstPassSegmentor);
             if (!ScalarImage::isImageAllZero<itkBinaryMaskImageType>(nucleusBinaryMask)) {
                 std::cout << "before CV\n" << std::flush;
                 // int numiter = 100;
 
                 // time_t start, end;
                 // time(&start);
-                CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType> cv;
-                cv.setImage(hemaFloat);
-                cv.setMask(nucleusBinaryMask);
-                cv.setNumIter(levelsetNumberOfIteration);
-                cv.setCurvatureWeight(curvatureWeight);
-                cv.doSegmentation();
+                firstPassSegmentor.setImage(hemaFloat);
+                // most of the front motion on the coarse grid, then a short refinement
+                itkUCharImageType::Pointer coarseMask;
+                if (levelSetOptions.pyramidLevels > 0) {
+                    coarseMask = coarseChanVeseMask<char>(hemaFloat, nucleusBinaryMask, levelsetNumberOfIteration,
+                                                          curvatureWeight, levelSetOptions, levelSetReport);
+                }
+
+                if (coarseMask) {
+                    firstPassSegmentor.setMask(coarseMask);
+                    firstPassSegmentor.setNumIter(levelSetOptions.pyramidRefinementIterations);
+                } else {
+                    firstPassSegmentor.setMask(nucleusBinaryMask);
+                    firstPassSegmentor.setNumIter(levelsetNumberOfIteration);
+                }
+                firstPassSegmentor.setCurvatureWeight(curvatureWeight);
+                firstPassSegmentor.setNumThreads(levelSetOptions.numberOfThreads);
+                firstPassSegmentor.setConvergenceTolerance(levelSetOptions.convergenceTolerance);
+                firstPassSegmentor.setInstrumentation(levelSetOptions.instrumentation);
+                firstPassSegmentor.doSegmentation();
+
+                if (levelSetReport) {
+                    levelSetReport->numberOfIterations = firstPassSegmentor.getNumIterDone();
+                    levelSetReport->iterationStats = firstPassSegmentor.getIterationStats();
+                }
                 // time(&end);
                 // double dif = difftime(end, start);
                 // std::cout << "Elasped time is " << dif << " seconds.\n" << std::flush;
 
                 std::cout << "after CV\n" << std::flush;
 
-                CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType>::LSImageType::Pointer phi = cv.mp_phi;
+                CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType>::LSImageType::Pointer phi = firstPassSegmentor.mp_phi;
 
                 itkUCharImageType::PixelType *nucleusBinaryMaskBufferPointer = nucleusBinaryMask->GetBufferPointer();
                 CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType>::LSImageType::PixelType *phiBufferPointer = phi->GetBufferPointer();
@@ -465,42 +1062,35 @@ namespace ImagenomicAnalytics {
             fhfilter->SetForegroundValue(1);
             fhfilter->Update();
 
-            typedef itk::ConnectedComponentImageFilter <itkBinaryMaskImageType, itkLabelImageType> ConnectedComponentImageFilterType;
-            ConnectedComponentImageFilterType::Pointer connected = ConnectedComponentImageFilterType::New();
-            connected->SetInput(nucleusBinaryMask);
-            connected->Update();
-
-            typedef itk::RelabelComponentImageFilter <itkLabelImageType, itkLabelImageType> FilterType;
-            FilterType::Pointer relabelFilter = FilterType::New();
-            relabelFilter->SetInput(connected->GetOutput());
-            relabelFilter->SetMinimumObjectSize(static_cast<FilterType::ObjectSizeType>(sizeThld / mpp / mpp));
-            relabelFilter->Update();
-
-            itkLabelImageType::Pointer tmpImg = relabelFilter->GetOutput();
-
-            itkUCharImageType::PixelType *nucleusBinaryMaskBufferPointer = nucleusBinaryMask->GetBufferPointer();
-            itkLabelImageType::PixelType *tmpImgBufferPointer = tmpImg->GetBufferPointer();
+            // Remove the objects smaller than sizeThld: same as connected
+            // components (4-connected) + relabel with a minimum object size,
+            // written straight back to the mask
+            {
+                itkBinaryMaskImageType::SizeType size = nucleusBinaryMask->GetLargestPossibleRegion().GetSize();
+                std::vector<int> componentLabels(numPixels);
 
-            for (unsigned long it = 0; it < numPixels; ++it) {
-                nucleusBinaryMaskBufferPointer[it] = tmpImgBufferPointer[it] > 0 ? 1 : 0;
+                nscale::ConnComponents cc;
+                cc.maskAreaOpening(nucleusBinaryMask->GetBufferPointer(), size[0], size[1], &componentLabels[0],
+                                   static_cast<int>(sizeThld / mpp / mpp), 4);
             }
 
 
             // SEGMENT: Declumping
+            // After the watershed the mask is a view of this
+            cv::Mat watershedMask;
             if (declumpingType > 0) {
                 if (!ScalarImage::isImageAllZero<itkBinaryMaskImageType>(nucleusBinaryMask)) {
 
                     // WATERSHED
                     if (declumpingType == 2) {
 
-                        cv::Mat watershedMask;
-                        cv::Mat seg = itk::OpenCVImageBridge::ITKImageToCVMat<itkUCharImageType>(nucleusBinaryMask);
+                        cv::Mat seg = ImageView::itkImageAsCVMat<itkUCharImageType>(nucleusBinaryMask);
 
                         // Modified method signature:
                         // const cv::Mat &img, const cv::Mat &seg_open, cv::Mat &seg_nonoverlap
                         nscale::HistologicalEntities::plSeparateNuclei(newImgCV, seg, watershedMask);
 
-                        nucleusBinaryMask = itk::OpenCVImageBridge::CVMatToITKImage<itkUCharImageType>(watershedMask);
+                        nucleusBinaryMask = ImageView::cvMatAsItkImage<itkUCharImageType>(watershedMask);
 
                     }
 
@@ -511,6 +1101,7 @@ namespace ImagenomicAnalytics {
                         binaryMaskAnalyzer.setObjectSizeThreshold(sizeThld);
                         binaryMaskAnalyzer.setObjectSizeUpperThreshold(sizeUpperThld);
                         binaryMaskAnalyzer.setMeanshiftSigma(msKernel);
+                        binaryMaskAnalyzer.setNumberOfThreads(tileOptions.numberOfThreads);
                         binaryMaskAnalyzer.setMPP(mpp);
                         // Assumes declumpingType==0
                         binaryMaskAnalyzer.update();
@@ -537,17 +1128,40 @@ namespace ImagenomicAnalytics {
             }
 
 
-            // SEGMENT: ChanVese again, with numiter = 50.
-            if (!ScalarImage::isImageAllZero<itkBinaryMaskImageType>(nucleusBinaryMask)) {
-                int numiter = 50;
-                CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType> cv;
-                cv.setImage(hemaFloat);
-                cv.setMask(nucleusBinaryMask);
-                cv.setNumIter(numiter);
-                cv.setCurvatureWeight(curvatureWeight);
-                cv.doSegmentation();
+            // SEGMENT: ChanVese again, with numiter = numberOfIterationsSecondPass (50).
+            if (levelSetOptions.secondPassPerObject && !ScalarImage::isImageAllZero<itkBinaryMaskImageType>(nucleusBinaryMask)) {
+                long numiterDone = chanVesePerObject<char>(hemaFloat, nucleusBinaryMask,
+                                                           levelSetOptions.numberOfIterationsSecondPass,
+                                                           curvatureWeight, levelSetOptions,
+                                                           levelSetReport ? &levelSetReport->iterationStatsSecondPass : NULL);
 
-                CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType>::LSImageType::Pointer phi = cv.mp_phi;
+                if (levelSetReport) {
+                    levelSetReport->numberOfIterationsSecondPass = numiterDone;
+                }
+            } else if (!ScalarImage::isImageAllZero<itkBinaryMaskImageType>(nucleusBinaryMask)) {
+                int numiter = levelSetOptions.numberOfIterationsSecondPass;
+                LocalChanVeseSegmentorType localSegmentor;
+                GlobalChanVeseSegmentorType globalSegmentor;
+                ChanVeseSegmentorType &segmentor = chanVeseSegmentor(levelSetOptions, localSegmentor, globalSegmentor);
+                segmentor.setImage(hemaFloat);
+                segmentor.setMask(nucleusBinaryMask);
+                segmentor.setNumIter(numiter);
+                segmentor.setCurvatureWeight(curvatureWeight);
+                segmentor.setNumThreads(levelSetOptions.numberOfThreads);
+                segmentor.setConvergenceTolerance(levelSetOptions.convergenceTolerance);
+                segmentor.setInstrumentation(levelSetOptions.instrumentation);
+                if (levelSetOptions.warmStartSecondPass && firstPassSegmentor.mp_phi) {
+                    // the first pass mask is phi <= 1.0, see above
+                    segmentor.initializeSFLSFromPrevious(firstPassSegmentor, 1.0);
+                }
+                segmentor.doSegmentation();
+
+                if (levelSetReport) {
+                    levelSetReport->numberOfIterationsSecondPass = segmentor.getNumIterDone();
+                    levelSetReport->iterationStatsSecondPass = segmentor.getIterationStats();
+                }
+
+                CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType>::LSImageType::Pointer phi = segmentor.mp_phi;
 
                 itkUCharImageType::PixelType *nucleusBinaryMaskBufferPointer = nucleusBinaryMask->GetBufferPointer();
                 CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType>::LSImageType::PixelType *phiBufferPointer = phi->GetBufferPointer();
@@ -588,19 +1202,24 @@ namespace ImagenomicAnalytics {
                                                            double mpp = 0.25, \
                                                            float msKernel = 20.0, \
                                                            int levelsetNumberOfIteration = 100, \
-                                                           int declumpingType = 0) {
+                                                           int declumpingType = 0, \
+                                                           const TileOptions &tileOptions = TileOptions(), \
+                                                           const LevelSetOptions &levelSetOptions = LevelSetOptions(), \
+                                                           LevelSetReport *levelSetReport = NULL) {
+            if (levelSetReport) {
+                *levelSetReport = LevelSetReport();
+            }
+
             std::cout << "normalizeImageColor.....\n" << std::flush;
-            cv::Mat newImgCV = normalizeImageColor<char>(thisTileCV);
+            cv::Mat newImgCV = normalizeImageColor<char>(thisTileCV, tileOptions.fusedColorNormalization,
+                                                          tileOptions.numberOfThreads);
 
             std::cout << "extractTissueMask.....\n" << std::flush;
-            itkUCharImageType::Pointer foregroundMask = extractTissueMask<char>(newImgCV);
-
-            itkRGBImageType::Pointer thisTile = itk::OpenCVImageBridge::CVMatToITKImage<itkRGBImageType>(thisTileCV);
-
-            //IO::writeImage<itkRGBImageType>(thisTile, "thisTile.png", 0);
+            cv::Mat foregroundMaskCV = extractTissueMaskCV<char>(newImgCV);
+            itkUCharImageType::Pointer foregroundMask = ImageView::cvMatAsItkImage<itkUCharImageType>(foregroundMaskCV);
 
             std::cout << "ExtractHematoxylinChannel.....\n" << std::flush;
-            itkUCharImageType::Pointer hematoxylinImage = ExtractHematoxylinChannel<char>(thisTile);
+            itkUCharImageType::Pointer hematoxylinImage = ExtractHematoxylinChannel<char>(thisTileCV, tileOptions.numberOfThreads);
 
             short maskValue = 1;
 
@@ -640,7 +1259,15 @@ namespace ImagenomicAnalytics {
                 cv.setMask(nucleusBinaryMask);
                 cv.setNumIter(levelsetNumberOfIteration);
                 cv.setCurvatureWeight(curvatureWeight);
+                cv.setNumThreads(levelSetOptions.numberOfThreads);
+                cv.setConvergenceTolerance(levelSetOptions.convergenceTolerance);
+                cv.setInstrumentation(levelSetOptions.instrumentation);
                 cv.doSegmentation();
+
+                if (levelSetReport) {
+                    levelSetReport->numberOfIterations = cv.getNumIterDone();
+                    levelSetReport->iterationStats = cv.getIterationStats();
+                }
                 // time(&end);
                 // double dif = difftime(end, start);
                 // std::cout << "Elasped time is " << dif << " seconds.\n" << std::flush;
@@ -664,6 +1291,7 @@ namespace ImagenomicAnalytics {
                     binaryMaskAnalyzer.setObjectSizeThreshold(sizeThld);
                     binaryMaskAnalyzer.setObjectSizeUpperThreshold(sizeUpperThld);
                     binaryMaskAnalyzer.setMeanshiftSigma(msKernel);
+                    binaryMaskAnalyzer.setNumberOfThreads(tileOptions.numberOfThreads);
                     binaryMaskAnalyzer.setMPP(mpp);
                     binaryMaskAnalyzer.update();
 
@@ -688,14 +1316,22 @@ namespace ImagenomicAnalytics {
 
 
             if (!ScalarImage::isImageAllZero<itkBinaryMaskImageType>(nucleusBinaryMask)) {
-                int numiter = 50;
+                int numiter = levelSetOptions.numberOfIterationsSecondPass;
                 CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType> cv;
                 cv.setImage(hemaFloat);
                 cv.setMask(nucleusBinaryMask);
                 cv.setNumIter(numiter);
                 cv.setCurvatureWeight(curvatureWeight);
+                cv.setNumThreads(levelSetOptions.numberOfThreads);
+                cv.setConvergenceTolerance(levelSetOptions.convergenceTolerance);
+                cv.setInstrumentation(levelSetOptions.instrumentation);
                 cv.doSegmentation();
 
+                if (levelSetReport) {
+                    levelSetReport->numberOfIterationsSecondPass = cv.getNumIterDone();
+                    levelSetReport->iterationStatsSecondPass = cv.getIterationStats();
+                }
+
                 CSFLSLocalChanVeseSegmentor2D<itkFloatImageType::PixelType>::LSImageType::Pointer phi = cv.mp_phi;
 
                 itkUCharImageType::PixelType *nucleusBinaryMaskBufferPointer = nucleusBinaryMask->GetBufferPointer();
@@ -727,19 +1363,18 @@ namespace ImagenomicAnalytics {
                                                       float sizeUpperThld = 200, \
                                                       double mpp = 0.25, \
                                                       float msKernel = 20.0, \
-                                                      int levelsetNumberOfIteration = 100) {
+                                                      int levelsetNumberOfIteration = 100, \
+                                                      const TileOptions &tileOptions = TileOptions()) {
             std::cout << "normalizeImageColor.....\n" << std::flush;
-            cv::Mat newImgCV = normalizeImageColor<char>(thisTileCV);
+            cv::Mat newImgCV = normalizeImageColor<char>(thisTileCV, tileOptions.fusedColorNormalization,
+                                                          tileOptions.numberOfThreads);
 
             std::cout << "extractTissueMask.....\n" << std::flush;
-            itkUCharImageType::Pointer foregroundMask = extractTissueMask<char>(newImgCV);
-
-            itkRGBImageType::Pointer thisTile = itk::OpenCVImageBridge::CVMatToITKImage<itkRGBImageType>(thisTileCV);
-
-            //IO::writeImage<itkRGBImageType>(thisTile, "thisTile.png", 0);
+            cv::Mat foregroundMaskCV = extractTissueMaskCV<char>(newImgCV);
+            itkUCharImageType::Pointer foregroundMask = ImageView::cvMatAsItkImage<itkUCharImageType>(foregroundMaskCV);
 
             std::cout << "ExtractHematoxylinChannel.....\n" << std::flush;
-            itkUCharImageType::Pointer hematoxylinImage = ExtractHematoxylinChannel<char>(thisTile);
+            itkUCharImageType::Pointer hematoxylinImage = ExtractHematoxylinChannel<char>(thisTileCV, tileOptions.numberOfThreads);
 
             short maskValue = 1;
 
@@ -801,6 +1436,7 @@ namespace ImagenomicAnalytics {
                 binaryMaskAnalyzer.setObjectSizeThreshold(sizeThld);
                 binaryMaskAnalyzer.setObjectSizeUpperThreshold(sizeUpperThld);
                 binaryMaskAnalyzer.setMeanshiftSigma(msKernel);
+                binaryMaskAnalyzer.setNumberOfThreads(tileOptions.numberOfThreads);
                 binaryMaskAnalyzer.setMPP(mpp);
                 binaryMaskAnalyzer.update();
 
@@ -834,14 +1470,17 @@ namespace ImagenomicAnalytics {
          * 2 = Watershed
          */
         cv::Mat processTileCV(cv::Mat thisTileCV, \
-                          float otsuRatio = 1.0, \
-                          double curvatureWeight = 0.8, \
-                          float sizeThld = 3, \
-                          float sizeUpperThld = 200, \
-                          double mpp = 0.25, \
-                          float msKernel = 20.0, \
-                          int levelsetNumberOfIteration = 100,
-                          int declumpingType = 0) {
+                          float otsuRatio, \
+                          double curvatureWeight, \
+                          float sizeThld, \
+                          float sizeUpperThld, \
+                          double mpp, \
+                          float msKernel, \
+                          int levelsetNumberOfIteration,
+                          int declumpingType,
+                          const TileOptions &tileOptions,
+                          const LevelSetOptions &levelSetOptions,
+                          LevelSetReport *levelSetReport) {
 
             itkUShortImageType::Pointer outputLabelImage;
 
@@ -855,7 +1494,10 @@ namespace ImagenomicAnalytics {
                                                                        mpp, \
                                                                        msKernel, \
                                                                        levelsetNumberOfIteration,
-                                                                       declumpingType);
+                                                                       declumpingType,
+                                                                       tileOptions,
+                                                                       levelSetOptions,
+                                                                       levelSetReport);
 
             // Transform from 1 to 255 does not work in our Slicer use-case.
 
@@ -870,11 +1512,141 @@ namespace ImagenomicAnalytics {
             }
 */
 
-            cv::Mat binary = itk::OpenCVImageBridge::ITKImageToCVMat<itkUCharImageType>(nucleusBinaryMask);
+            // the mask is freed on return: one copy, where the bridge makes two
+            cv::Mat binary = ImageView::itkImageAsCVMat<itkUCharImageType>(nucleusBinaryMask).clone();
             return binary;
 
         }
 
 
+        // Hematoxylin and eosin channels of the tiles, one tile per task
+        class StainChannelsBody : public cv::ParallelLoopBody {
+        public:
+            StainChannelsBody(const std::vector<cv::Mat> &tiles, std::vector<itkUCharImageType::Pointer> &hematoxylin,
+                              std::vector<itkUCharImageType::Pointer> &eosin)
+                    : m_tiles(tiles), m_hematoxylin(hematoxylin), m_eosin(eosin) {}
+
+            virtual void operator()(const cv::Range &range) const {
+                for (int it = range.start; it < range.end; ++it) {
+                    m_hematoxylin[it] = ExtractStainChannel<char>(m_tiles[it], 0);
+                    m_eosin[it] = ExtractStainChannel<char>(m_tiles[it], 1);
+                }
+            }
+
+        private:
+            const std::vector<cv::Mat> &m_tiles;
+            std::vector<itkUCharImageType::Pointer> &m_hematoxylin;
+            std::vector<itkUCharImageType::Pointer> &m_eosin;
+        };
+
+
+        // Features of the tiles, from label buffers of the size of the tiles
+        void computeNucleusFeaturesOfLabels(const std::vector<cv::Mat> &tiles, \
+                                            const std::vector<const gth818n::NucleusFeatureEngine::LabelType *> &labels, \
+                                            const std::vector<cv::Point> &tileOrigins, \
+                                            double mpp, \
+                                            int numberOfThreads, \
+                                            gth818n::NucleusFeatureTable &featureTable) {
+            int numberOfTiles = static_cast<int>(tiles.size());
+
+            std::vector<itkUCharImageType::Pointer> hematoxylin(numberOfTiles);
+            std::vector<itkUCharImageType::Pointer> eosin(numberOfTiles);
+
+            StainChannelsBody stainChannels(tiles, hematoxylin, eosin);
+            if (1 == numberOfThreads) {
+                stainChannels(cv::Range(0, numberOfTiles));
+            } else {
+                cv::parallel_for_(cv::Range(0, numberOfTiles), stainChannels);
+            }
+
+            gth818n::NucleusFeatureEngine featureEngine;
+            featureEngine.setMPP(mpp);
+            featureEngine.setNumberOfThreads(numberOfThreads);
+
+            for (int it = 0; it < numberOfTiles; ++it) {
+                featureEngine.addTile(labels[it], \
+                                      hematoxylin[it]->GetBufferPointer(), \
+                                      eosin[it]->GetBufferPointer(), \
+                                      tiles[it].cols, tiles[it].rows, tileOrigins[it].x, tileOrigins[it].y);
+            }
+
+            featureEngine.update();
+
+            featureTable = featureEngine.getFeatureTable();
+        }
+
+
+        void computeNucleusFeaturesCV(const std::vector<cv::Mat> &tiles, \
+                                      const std::vector<cv::Mat> &labels, \
+                                      const std::vector<cv::Point> &tileOrigins, \
+                                      double mpp, \
+                                      int numberOfThreads, \
+                                      gth818n::NucleusFeatureTable &featureTable) {
+            if (labels.size() != tiles.size() || tileOrigins.size() != tiles.size()) {
+                std::cerr << "Error: need one label image and one origin per tile.\n";
+                abort();
+            }
+
+            std::vector<const gth818n::NucleusFeatureEngine::LabelType *> labelBuffers(tiles.size());
+
+            for (std::size_t it = 0; it < tiles.size(); ++it) {
+                if (labels[it].type() != CV_32S || !labels[it].isContinuous() || labels[it].size() != tiles[it].size()) {
+                    std::cerr << "Error: label image " << it << " should be a continuous CV_32S image of the size of its tile.\n";
+                    abort();
+                }
+
+                // e.g. the -1 borders of cv::watershed: not a nucleus, and
+                // not 0 either once read as unsigned
+                double minLabel;
+                cv::minMaxLoc(labels[it], &minLabel, NULL);
+                if (minLabel < 0) {
+                    std::cerr << "Error: label image " << it << " has negative labels.\n";
+                    abort();
+                }
+
+                labelBuffers[it] = reinterpret_cast<const gth818n::NucleusFeatureEngine::LabelType *>(labels[it].ptr<int>());
+            }
+
+            computeNucleusFeaturesOfLabels(tiles, labelBuffers, tileOrigins, mpp, numberOfThreads, featureTable);
+        }
+
+
+        void computeNucleusFeatures(const std::vector<cv::Mat> &tiles, \
+                                    const std::vector<itkUIntImageType::Pointer> &labels, \
+                                    const std::vector<cv::Point> &tileOrigins, \
+                                    double mpp, \
+                                    int numberOfThreads, \
+                                    gth818n::NucleusFeatureTable &featureTable) {
+            if (labels.size() != tiles.size() || tileOrigins.size() != tiles.size()) {
+                std::cerr << "Error: need one label image and one origin per tile.\n";
+                abort();
+            }
+
+            std::vector<const gth818n::NucleusFeatureEngine::LabelType *> labelBuffers(tiles.size());
+
+            // processTileOutputLabel gives no label image when there is no
+            // nucleus: an all 0 one instead
+            std::vector< std::vector<gth818n::NucleusFeatureEngine::LabelType> > emptyLabels(tiles.size());
+
+            for (std::size_t it = 0; it < tiles.size(); ++it) {
+                if (!labels[it]) {
+                    emptyLabels[it].assign(tiles[it].total(), 0);
+                    labelBuffers[it] = tiles[it].total() > 0 ? &emptyLabels[it][0] : NULL;
+                    continue;
+                }
+
+                itkUIntImageType::SizeType size = labels[it]->GetLargestPossibleRegion().GetSize();
+                if (static_cast<int>(size[0]) != tiles[it].cols || static_cast<int>(size[1]) != tiles[it].rows) {
+                    std::cerr << "Error: label image " << it << " should be of the size of its tile.\n";
+                    abort();
+                }
+
+                labelBuffers[it] = labels[it]->GetBufferPointer();
+            }
+
+            computeNucleusFeaturesOfLabels(tiles, labelBuffers, tileOrigins, mpp, numberOfThreads, featureTable);
+        }
+
+
     }
 }// namespace
@@ -1,7 +1,78 @@
 #ifndef utilitiesTileAnalysis_h_
 #define utilitiesTileAnalysis_h_
+
+#include <vector>
+
+#include "itkTypedefs.h"
+#include "SFLSIterationStats.h"
+#include "NucleusFeatureEngine.h"
+
 namespace ImagenomicAnalytics {
     namespace TileAnalysis {
+        /**
+         * Options of the stages of processTile around the level sets:
+         * color normalization, stain extraction, declumping and the
+         * nucleus features. The defaults give the original behavior.
+         */
+        struct TileOptions {
+            int numberOfThreads; ///< 1: serial. Otherwise normalize and extract the stains by rows in parallel, and declump objects in parallel, at most n at a time (<= 0: all of OpenCV's threads). Same output for any value
+            bool fusedColorNormalization; ///< Normalization::fusedNormalization, within 1 gray level of the original
+
+            TileOptions() : numberOfThreads(1), fusedColorNormalization(false) {}
+        };
+
+        /**
+         * Options of the Chan-Vese level set stages of processTile.
+         * The defaults give the original behavior.
+         */
+        struct LevelSetOptions {
+            int numberOfThreads; ///< 1: serial. n > 1: evolve in parallel strips, and the per-object second pass objects in parallel, at most n at a time. <= 0: all of OpenCV's threads. The strips give the same mask for any value but 1, which can differ from the serial mask by a few boundary pixels, see CSFLSSegmentor2D::setNumThreads
+            double convergenceTolerance; ///< stop when <= tol*|zero layer| pixels move per iteration. <= 0: never stop early
+            int numberOfIterationsSecondPass; ///< iteration cap of the level set after declumping
+            bool secondPassPerObject; ///< run the second pass on each object's padded bounding box, in parallel. Follows globalChanVese and instrumentation; error with warmStartSecondPass
+            int secondPassPadding; ///< padding of the bounding boxes, in pixels
+            bool warmStartSecondPass; ///< start the second pass from the first pass phi and layers (error if secondPassPerObject)
+            bool instrumentation; ///< fill the iteration stats of LevelSetReport
+            int pyramidLevels; ///< 0: off. 1, 2: run the first pass on the 2x, 4x downsampled image first (the plain first pass if that finds nothing). Error otherwise
+            int pyramidRefinementIterations; ///< full resolution iterations after the coarse first pass, >= 0
+            bool globalChanVese; ///< processTile: image-wide inside/outside means instead of local windows. The per-object second pass uses the tile's, fixed
+
+            LevelSetOptions() : numberOfThreads(1), convergenceTolerance(0.0), numberOfIterationsSecondPass(50),
+                                secondPassPerObject(false), secondPassPadding(10), warmStartSecondPass(false),
+                                instrumentation(false), pyramidLevels(0), pyramidRefinementIterations(20),
+                                globalChanVese(false) {}
+        };
+
+        /**
+         * Iterations actually run by the Chan-Vese stages of processTile.
+         * 0 when a stage did not run (e.g. empty mask).
+         * With LevelSetOptions::instrumentation, also what each iteration
+         * did; for the per-object second pass, summed over the objects.
+         */
+        struct LevelSetReport {
+            long numberOfIterations;
+            long numberOfIterationsCoarse; ///< coarse grid iterations of the pyramid mode
+            long numberOfIterationsSecondPass;
+            std::vector<CSFLSIterationStats> iterationStats;
+            std::vector<CSFLSIterationStats> iterationStatsSecondPass;
+
+            LevelSetReport() : numberOfIterations(0), numberOfIterationsCoarse(0), numberOfIterationsSecondPass(0) {}
+
+            /// Totals of the iteration stats of pass 1 or 2, for the caller to log
+            void summarizePass(int pass, double &forceSeconds, double &evolutionSeconds, unsigned long &maxLz) const {
+                const std::vector<CSFLSIterationStats> &stats = 1 == pass ? iterationStats : iterationStatsSecondPass;
+
+                forceSeconds = 0.0;
+                evolutionSeconds = 0.0;
+                maxLz = 0;
+                for (std::size_t it = 0; it < stats.size(); ++it) {
+                    forceSeconds += stats[it].m_forceSeconds;
+                    evolutionSeconds += stats[it].m_evolutionSeconds;
+                    maxLz = stats[it].m_lz > maxLz ? stats[it].m_lz : maxLz;
+                }
+            }
+        };
+
         cv::Mat processTileCV(cv::Mat thisTileCV, \
                           float otsuRatio = 1.0, \
                           double curvatureWeight = 0.8, \
@@ -10,7 +81,37 @@ namespace ImagenomicAnalytics {
                           double mpp = 0.25, \
                           float msKernel = 20.0, \
                           int levelsetNumberOfIteration = 100,
-                          int seg_type = 0);
+                          int seg_type = 0,
+                          const TileOptions &tileOptions = TileOptions(),
+                          const LevelSetOptions &levelSetOptions = LevelSetOptions(),
+                          LevelSetReport *levelSetReport = NULL);
+
+        /**
+         * Per-nucleus features of segmented tiles, one row per nucleus.
+         * labels[i]: CV_32S, continuous, the label image of tiles[i], 0
+         * the background (e.g. the connected components of the
+         * processTileCV mask). tileOrigins[i]: position of tiles[i] in
+         * the slide, added to the centroids. The stain channels are
+         * from the same color deconvolution as processTileCV.
+         * numberOfThreads 1: serial, otherwise tiles in parallel.
+         */
+        void computeNucleusFeaturesCV(const std::vector<cv::Mat> &tiles, \
+                                      const std::vector<cv::Mat> &labels, \
+                                      const std::vector<cv::Point> &tileOrigins, \
+                                      double mpp, \
+                                      int numberOfThreads, \
+                                      gth818n::NucleusFeatureTable &featureTable);
+
+        /**
+         * Same, with the label images of processTileOutputLabel. A null
+         * label image is a tile without nuclei.
+         */
+        void computeNucleusFeatures(const std::vector<cv::Mat> &tiles, \
+                                    const std::vector<itkUIntImageType::Pointer> &labels, \
+                                    const std::vector<cv::Point> &tileOrigins, \
+                                    double mpp, \
+                                    int numberOfThreads, \
+                                    gth818n::NucleusFeatureTable &featureTable);
     }
 }
 #endif
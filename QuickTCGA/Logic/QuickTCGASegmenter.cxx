@@ -91,6 +91,10 @@ void QuickTCGASegmenter::GetSegmentation(cv::Mat &imSeg) {
     imSeg = m_imLab;
 }
 
+void QuickTCGASegmenter::GetLevelSetReport(ImagenomicAnalytics::TileAnalysis::LevelSetReport &levelSetReport) {
+    levelSetReport = m_levelSetReport;
+}
+
 void QuickTCGASegmenter::ComputeFeatureImage() {
 
     std::vector <cv::Mat> imBGR;
@@ -156,9 +160,10 @@ void QuickTCGASegmenter::DoSegmentation() {
 // void QuickTCGASegmenter::DoNucleiSegmentationYi(...)
 void QuickTCGASegmenter::DoNuclearSegmentation(float otsuRatio, double curvatureWeight, float sizeThld,
                                                 float sizeUpperThld, double mpp, float kernelSize,
-                                                int declumpingType = 0) {
+                                                int declumpingType, int levelsetNumberOfIteration,
+                                                const ImagenomicAnalytics::TileAnalysis::TileOptions &tileOptions,
+                                                const ImagenomicAnalytics::TileAnalysis::LevelSetOptions &levelSetOptions) {
 
-    int levelsetNumberOfIteration = 100;
     // Resize image for higher efficiency
     double samratio = 1;
     cv::resize(m_imSrc, m_imSrcSample, cv::Size(m_imSrc.cols * samratio, m_imSrc.rows * samratio), cv::INTER_LINEAR);
@@ -166,7 +171,8 @@ void QuickTCGASegmenter::DoNuclearSegmentation(float otsuRatio, double curvature
     std::cout << "doing new processTile\n";
     cv::Mat seg = ImagenomicAnalytics::TileAnalysis::processTileCV(m_imSrcSample, otsuRatio, curvatureWeight, sizeThld,
                                                                    sizeUpperThld, mpp, kernelSize,
-                                                                   levelsetNumberOfIteration, declumpingType);
+                                                                   levelsetNumberOfIteration, declumpingType,
+                                                                   tileOptions, levelSetOptions, &m_levelSetReport);
     // std::cout << "seg" << seg << "\n";
 
     cv::resize(seg, m_imLab, cv::Size(m_imLab.cols, m_imLab.rows), cv::INTER_NEAREST);
@@ -175,6 +181,25 @@ void QuickTCGASegmenter::DoNuclearSegmentation(float otsuRatio, double curvature
 }
 
 
+void QuickTCGASegmenter::WriteNucleusFeatures(double mpp,
+                                              const ImagenomicAnalytics::TileAnalysis::TileOptions &tileOptions,
+                                              const std::string &fileName) {
+    // the nuclei are the connected components of the last segmentation
+    std::vector<cv::Mat> tiles(1, m_imSrc);
+    std::vector<cv::Mat> labels(1);
+    std::vector<cv::Point> tileOrigins(1, cv::Point(0, 0));
+    cv::connectedComponents(m_imLab != 0, labels[0], 4, CV_32S);
+
+    gth818n::NucleusFeatureTable featureTable;
+    ImagenomicAnalytics::TileAnalysis::computeNucleusFeaturesCV(tiles, labels, tileOrigins, mpp,
+                                                                tileOptions.numberOfThreads, featureTable);
+
+    featureTable.write(fileName);
+
+    std::cout << "Wrote the features of " << featureTable.size() << " nuclei to " << fileName << "\n";
+}
+
+
 void QuickTCGASegmenter::RefineCurvature() {
 
     // Resize image for higher efficiency
@@ -37,10 +37,21 @@ public:
     // DoNucleiSegmentationYiwo(...)
     void
     DoNuclearSegmentation(float otsuRatio, double curvatureWeight, float sizeThld, float sizeUpperThld, double mpp,
-                          float kernelSize, int declumpingType);
+                          float kernelSize, int declumpingType, int levelsetNumberOfIteration,
+                          const ImagenomicAnalytics::TileAnalysis::TileOptions &tileOptions,
+                          const ImagenomicAnalytics::TileAnalysis::LevelSetOptions &levelSetOptions);
+
+    // Features of the nuclei of the last DoNuclearSegmentation, the
+    // connected components of the lab image, written as a
+    // NucleusFeatureTable. mpp of the source image
+    void WriteNucleusFeatures(double mpp, const ImagenomicAnalytics::TileAnalysis::TileOptions &tileOptions,
+                              const std::string &fileName);
 
     void GetSegmentation(cv::Mat &imSeg);
 
+    // iterations run by the level set stages of the last DoNuclearSegmentation
+    void GetLevelSetReport(ImagenomicAnalytics::TileAnalysis::LevelSetReport &levelSetReport);
+
     void RefineCurvature();
 
     void RefineShortCut();
@@ -67,6 +78,7 @@ private:
     static const int m_STRELE_SIZE;
     std::vector <std::vector<cv::Point> > m_contours;
     std::vector <cv::Vec4i> m_hierarchy;
+    ImagenomicAnalytics::TileAnalysis::LevelSetReport m_levelSetReport;
 };
 
 #endif
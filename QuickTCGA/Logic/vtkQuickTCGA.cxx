@@ -27,6 +27,17 @@ vtkQuickTCGA::vtkQuickTCGA() {
     sizeUpperThld = 200;
     mpp = 0.25;
     kernelSize = 20.0;
+    numberOfThreads = 1;
+    levelsetNumberOfIterations = 100;
+    levelsetConvergenceTolerance = 0.0;
+    levelsetSecondPassPerObject = false;
+    levelsetWarmStartSecondPass = false;
+    levelsetInstrumentation = false;
+    levelsetPyramidLevels = 0;
+    levelsetGlobalChanVese = false;
+    nucleusFeatureFileName = NULL;
+    levelsetNumberOfIterationsUsed = 0;
+    levelsetNumberOfIterationsSecondPassUsed = 0;
 }
 
 vtkQuickTCGA::~vtkQuickTCGA() {
@@ -47,6 +58,7 @@ vtkQuickTCGA::~vtkQuickTCGA() {
     if (m_qTCGASeg) {
         delete m_qTCGASeg;
     }
+    this->SetnucleusFeatureFileName(NULL);
 }
 
 void vtkQuickTCGA::Initialization() {
@@ -98,14 +110,46 @@ void vtkQuickTCGA::Run_NucleiSegYi(int seg_type) {
     m_qTCGASeg->SetSourceImage(m_imSrc);
     m_qTCGASeg->SetLabImage(m_imLab);
 
+    ImagenomicAnalytics::TileAnalysis::TileOptions tileOptions;
+    tileOptions.numberOfThreads = numberOfThreads;
+
+    ImagenomicAnalytics::TileAnalysis::LevelSetOptions levelSetOptions;
+    levelSetOptions.numberOfThreads = numberOfThreads;
+    levelSetOptions.convergenceTolerance = levelsetConvergenceTolerance;
+    levelSetOptions.secondPassPerObject = levelsetSecondPassPerObject;
+    levelSetOptions.warmStartSecondPass = levelsetWarmStartSecondPass;
+    levelSetOptions.instrumentation = levelsetInstrumentation;
+    levelSetOptions.pyramidLevels = levelsetPyramidLevels;
+    levelSetOptions.globalChanVese = levelsetGlobalChanVese;
+
     // DoNucleiSegmentationYi(...)
-    m_qTCGASeg->DoNuclearSegmentation(otsuRatio, curvatureWeight, sizeThld, sizeUpperThld, mpp, kernelSize, seg_type);
+    m_qTCGASeg->DoNuclearSegmentation(otsuRatio, curvatureWeight, sizeThld, sizeUpperThld, mpp, kernelSize, seg_type,
+                                      levelsetNumberOfIterations, tileOptions, levelSetOptions);
+
+    m_qTCGASeg->GetLevelSetReport(m_levelSetReport);
+    levelsetNumberOfIterationsUsed = m_levelSetReport.numberOfIterations;
+    levelsetNumberOfIterationsSecondPassUsed = m_levelSetReport.numberOfIterationsSecondPass;
+
+    if (levelsetInstrumentation) {
+        for (int pass = 1; pass <= 2; ++pass) {
+            double forceSeconds;
+            double evolutionSeconds;
+            unsigned long maxLz;
+            m_levelSetReport.summarizePass(pass, forceSeconds, evolutionSeconds, maxLz);
+            vtkDebugMacro(<< "Level set pass " << pass << ": force " << forceSeconds << " s, evolution "
+                          << evolutionSeconds << " s, max |Lz| " << maxLz);
+        }
+    }
 
     m_qTCGASeg->GetSegmentation(m_imLab);
 
     // Convert lplImage to vtkImage and update SeedVol
     TCGA::CopyImageOpenCV2VTK<uchar, short>(m_imLab, SeedVol);
 
+    if (nucleusFeatureFileName && nucleusFeatureFileName[0]) {
+        m_qTCGASeg->WriteNucleusFeatures(mpp, tileOptions, nucleusFeatureFileName);
+    }
+
     std::cout << "Finished TCGA segmentation\n";
 }
 
@@ -33,6 +33,26 @@ public:
   vtkSetMacro(sizeUpperThld, float);
   vtkSetMacro(mpp, double);
   vtkSetMacro(kernelSize, double);
+  vtkSetMacro(numberOfThreads, int);
+  vtkSetMacro(levelsetNumberOfIterations, int);
+  vtkSetMacro(levelsetConvergenceTolerance, double);
+  vtkSetMacro(levelsetSecondPassPerObject, bool);
+  vtkSetMacro(levelsetWarmStartSecondPass, bool);
+  vtkSetMacro(levelsetInstrumentation, bool);
+  vtkSetMacro(levelsetPyramidLevels, int);
+  vtkSetMacro(levelsetGlobalChanVese, bool);
+
+  // if set, Run_NucleiSegYi also writes the features of the nuclei it
+  // segmented to this file (NucleusFeatureTable format)
+  vtkSetStringMacro(nucleusFeatureFileName);
+  vtkGetStringMacro(nucleusFeatureFileName);
+
+  // iterations actually run by the last Run_NucleiSegYi
+  vtkGetMacro(levelsetNumberOfIterationsUsed, int);
+  vtkGetMacro(levelsetNumberOfIterationsSecondPassUsed, int);
+
+  // per-iteration stats of the last Run_NucleiSegYi, if levelsetInstrumentation
+  const ImagenomicAnalytics::TileAnalysis::LevelSetReport& GetLevelSetReport() const { return m_levelSetReport; }
 
   // vtkSetObjectMacro(OutputVol, vtkImageData);
 
@@ -64,12 +84,25 @@ private:
   float sizeUpperThld;
   double mpp;
   float kernelSize;
+  int numberOfThreads;
+  int levelsetNumberOfIterations;
+  double levelsetConvergenceTolerance;
+  bool levelsetSecondPassPerObject;
+  bool levelsetWarmStartSecondPass;
+  bool levelsetInstrumentation;
+  int levelsetPyramidLevels;
+  bool levelsetGlobalChanVese;
+  char* nucleusFeatureFileName;
+  int levelsetNumberOfIterationsUsed;
+  int levelsetNumberOfIterationsSecondPassUsed;
 
   cv::Mat m_imSrc;
   cv::Mat m_imLab;
   cv::Mat m_imPreSeg;
   cv::Mat m_imSCROI;
 
+  ImagenomicAnalytics::TileAnalysis::LevelSetReport m_levelSetReport;
+
   // logic code
   QuickTCGASegmenter* m_qTCGASeg;
 